@@ -160,6 +160,13 @@ while [ -f $EXEC_PATH ]; do
 	
 	if [ -f $NEXT_PATH ]; then
 		CMD=`cat $NEXT_PATH`
+		# let minarch initialize while the pak's launch.sh runs, it hands over through /tmp/minarch.sock
+		# only for paks marked as running minarch, any other emulator would share the display and input with it
+		EMU_PAK=$(dirname "$(echo "$CMD" | cut -d"'" -f2)")
+		if [ -f "$SHARED_USERDATA_PATH/enable-warm-start" ] && [ -f "$EMU_PAK/warm-start" ]; then
+			touch /tmp/minarch.warm
+			(HOME="$USERDATA_PATH"; cd "$HOME" && minarch.elf --warm &> $LOGS_PATH/minarch-warm.txt &)
+		fi
 		eval $CMD
 		rm -f $NEXT_PATH
 		echo $CPU_SPEED_PERF > $CPU_PATH
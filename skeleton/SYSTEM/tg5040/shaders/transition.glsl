@@ -0,0 +1,28 @@
+#if defined(VERTEX)
+attribute vec2 VertexCoord;
+attribute vec2 TexCoord;
+varying vec2 vTexCoord;
+
+void main() {
+    vTexCoord = TexCoord;
+    gl_Position = vec4(VertexCoord, 0.0, 1.0);
+}
+#endif
+
+#if defined(FRAGMENT)
+precision mediump float;
+uniform float Progress; // 0 is black, 1 is fully shown
+uniform int Mode; // 0 fade, 1 circle reveal
+uniform vec2 OutputSize;
+varying vec2 vTexCoord;
+
+void main() {
+    float eased = Progress * Progress * (3.0 - 2.0 * Progress);
+    float alpha = 1.0 - eased;
+    if (Mode == 1) {
+        vec2 p = (vTexCoord - 0.5) * OutputSize;
+        alpha = length(p) > eased * length(OutputSize) * 0.5 ? 1.0 : 0.0;
+    }
+    gl_FragColor = vec4(0.0, 0.0, 0.0, alpha);
+}
+#endif
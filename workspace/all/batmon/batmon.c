@@ -6,6 +6,10 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #include <defines.h>
 #include <api.h>
@@ -17,15 +21,34 @@
 
 // Battery logs
 #define FILO_MIN_SIZE 1000
-#define MAX_DURATION_BEFORE_UPDATE 600
+#define FLUSH_INTERVAL_S 300 // s - commit buffered samples every 5 minutes
+#define SAMPLE_BUFFER_SIZE 64
 
 static bool quit = false;
 static bool is_suspended = false;
+static volatile bool flush_and_stop = false;
 
 int battery_current_state_duration = 0;
 int best_session_time = 0;
 char *device_model = NULL;
 
+// held open for the life of the daemon
+static sqlite3 *bat_log_db = NULL;
+
+// samples wait here until the next flush, each one collects the
+// seconds spent at its level until the next sample closes it
+typedef struct BatSample {
+    int bat_level;
+    int is_charging;
+    int duration;
+} BatSample;
+static BatSample samples[SAMPLE_BUFFER_SIZE];
+static int sample_count = 0;
+static int tail_duration = 0; // seconds owed to the newest row already in the db
+static int tail_is_charging = 0;
+static int running_session = 0; // mirrors bat_session, on battery since the last charge
+static int flushes = 0;
+
 void register_handler();
 void sigintHandler(int signum) {
     switch (signum)
@@ -40,6 +63,10 @@ void sigintHandler(int signum) {
     case SIGCONT:
         is_suspended = false;
         break;
+    case SIGUSR1:
+        // sent instead of a bare STOP before sleep/poweroff
+        flush_and_stop = true;
+        break;
     default:
         break;
     }
@@ -66,6 +93,10 @@ void register_handler() {
     sigemptyset(&sa.sa_mask);
     sigaddset(&sa.sa_mask, SIGCONT);
     sigaction(SIGCONT, &sa, 0);
+
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, SIGUSR1);
+    sigaction(SIGUSR1, &sa, 0);
 }
 
 void cleanup(void)
@@ -73,133 +104,118 @@ void cleanup(void)
     remove("/tmp/percBat");
 }
 
+// hands the seconds counted since the last call to the open sample
 void update_current_duration(void)
 {
-    sqlite3 *bat_log_db = open_battery_log_db();
+    if (sample_count)
+        samples[sample_count - 1].duration += battery_current_state_duration;
+    else
+        tail_duration += battery_current_state_duration;
+    battery_current_state_duration = 0;
+}
 
-    if (bat_log_db != NULL)
-    {
-        const char *sql = "SELECT * FROM bat_activity WHERE device_serial = ? ORDER BY id DESC LIMIT 1;";
-        sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(bat_log_db, sql, -1, &stmt, 0);
+void flush_samples(void)
+{
+    update_current_duration();
+    if (!bat_log_db || (!sample_count && !tail_duration))
+        return;
+
+    static sqlite3_stmt *tail_stmt = NULL;
+    static sqlite3_stmt *insert_stmt = NULL;
+    static sqlite3_stmt *trim_stmt = NULL;
+    if (!tail_stmt) {
+        sqlite3_prepare_v2(bat_log_db, "UPDATE bat_activity SET duration = duration + ?1 WHERE id = (SELECT MAX(id) FROM bat_activity WHERE device_serial = ?2);", -1, &tail_stmt, NULL);
+        sqlite3_prepare_v2(bat_log_db, "INSERT INTO bat_activity(device_serial, bat_level, duration, is_charging) VALUES(?1, ?2, ?3, ?4);", -1, &insert_stmt, NULL);
+        // FILO logic, keep the newest FILO_MIN_SIZE entries
+        sqlite3_prepare_v2(bat_log_db, "DELETE FROM bat_activity WHERE id <= (SELECT MAX(id) FROM bat_activity) - ?1;", -1, &trim_stmt, NULL);
+    }
+    if (!tail_stmt || !insert_stmt || !trim_stmt)
+        return;
+
+    sqlite3_exec(bat_log_db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+
+    // a charging sample starts a new session, time at any other level adds to it
+    int new_session_time = running_session;
+    if (!tail_is_charging)
+        new_session_time += tail_duration;
+    for (int i = 0; i < sample_count; i++)
+        new_session_time = samples[i].is_charging ? 0 : new_session_time + samples[i].duration;
+
+    if (tail_duration) {
+        sqlite3_bind_int(tail_stmt, 1, tail_duration);
+        sqlite3_bind_text(tail_stmt, 2, device_model, -1, SQLITE_STATIC);
+        sqlite3_step(tail_stmt);
+        sqlite3_reset(tail_stmt);
+    }
 
-        if (rc == SQLITE_OK)
-        {
-            sqlite3_bind_text(stmt, 1, device_model, -1, SQLITE_STATIC);
-            rc = sqlite3_step(stmt);
-            if (rc == SQLITE_ROW)
-            {
-                int current_duration = sqlite3_column_int(stmt, 3);
-                int new_duration = current_duration + battery_current_state_duration;
+    for (int i = 0; i < sample_count; i++) {
+        sqlite3_bind_text(insert_stmt, 1, device_model, -1, SQLITE_STATIC);
+        sqlite3_bind_int(insert_stmt, 2, samples[i].bat_level);
+        sqlite3_bind_int(insert_stmt, 3, samples[i].duration);
+        sqlite3_bind_int(insert_stmt, 4, samples[i].is_charging);
+        sqlite3_step(insert_stmt);
+        sqlite3_reset(insert_stmt);
+    }
 
-                const char *update_sql = "UPDATE bat_activity SET duration = ? WHERE id = ?";
+    set_session_time(bat_log_db, device_model, new_session_time);
 
-                sqlite3_stmt *update_stmt;
-                rc = sqlite3_prepare_v2(bat_log_db, update_sql, -1, &update_stmt, 0);
+    sqlite3_bind_int(trim_stmt, 1, FILO_MIN_SIZE);
+    sqlite3_step(trim_stmt);
+    sqlite3_reset(trim_stmt);
 
-                if (rc == SQLITE_OK)
-                {
-                    sqlite3_bind_int(update_stmt, 1, new_duration);
-                    sqlite3_bind_int(update_stmt, 2, sqlite3_column_int(stmt, 0));
+    if (sqlite3_exec(bat_log_db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+        LOG_debug("battery log flush failed: %s\n", sqlite3_errmsg(bat_log_db));
+        sqlite3_exec(bat_log_db, "ROLLBACK;", NULL, NULL, NULL);
+        return; // keep the buffer and try again next time
+    }
 
-                    // Exécuter la mise à jour
-                    rc = sqlite3_step(update_stmt);
+    flushes++;
+    LOG_debug("flushed %d battery samples (%d flushes)\n", sample_count, flushes);
 
-                    battery_current_state_duration = 0;
-                    sqlite3_finalize(stmt);
-                    sqlite3_finalize(update_stmt);
-                }
-            }
-        }
-        close_battery_log_db(bat_log_db);
-    }
+    // the newest sample is the db tail now and keeps collecting time
+    if (sample_count)
+        tail_is_charging = samples[sample_count - 1].is_charging;
+    running_session = new_session_time;
+    sample_count = 0;
+    tail_duration = 0;
 }
 
 void log_new_percentage(int new_bat_value, int is_charging)
 {
-    sqlite3 *bat_log_db = open_battery_log_db();
-
-    if (bat_log_db != NULL)
-    {
-        char *sql = sqlite3_mprintf("INSERT INTO bat_activity(device_serial, bat_level, duration, is_charging) VALUES(%Q, %d, %d, %d);", device_model, new_bat_value, 0, is_charging);
-        sqlite3_exec(bat_log_db, sql, NULL, NULL, NULL);
-        sqlite3_free(sql);
-
-        // FILO logic
-        sqlite3_stmt *stmt;
-        const char *count_sql = "SELECT COUNT(id) FROM bat_activity";
-
-        int count = 0;
+    if (sample_count == SAMPLE_BUFFER_SIZE)
+        flush_samples();
+
+    samples[sample_count++] = (BatSample){
+        .bat_level = new_bat_value,
+        .is_charging = is_charging,
+        .duration = 0,
+    };
+}
 
-        if (sqlite3_prepare_v2(bat_log_db, count_sql, -1, &stmt, NULL) == SQLITE_OK)
-        {
-            if (sqlite3_step(stmt) == SQLITE_ROW)
-            {
-                count = sqlite3_column_int(stmt, 0);
-            }
-            sqlite3_finalize(stmt);
-        }
+// picks up where the last run left the session and the db tail
+void load_session(void)
+{
+    running_session = get_session_time(bat_log_db, device_model);
 
-        if (count > FILO_MIN_SIZE)
-        {
-            // Deletion of the 1st entry
-            const char *delete_sql = "DELETE FROM bat_activity WHERE id = (SELECT MIN(id) FROM bat_activity);";
-            sqlite3_prepare_v2(bat_log_db, delete_sql, -1, &stmt, 0);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
-        }
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(bat_log_db, "SELECT is_charging FROM bat_activity WHERE device_serial = ? ORDER BY id DESC LIMIT 1;", -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, device_model, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            tail_is_charging = sqlite3_column_int(stmt, 0);
     }
-    close_battery_log_db(bat_log_db);
+    sqlite3_finalize(stmt);
 }
 
+// only valid right after a flush, which every caller does first
 int get_current_session_time(void)
 {
-    int current_session_duration = 0;
-
-    sqlite3 *bat_log_db = open_battery_log_db();
-    
-    if (bat_log_db != NULL)
-    {
-        const char *sql = "SELECT * FROM bat_activity WHERE device_serial = ? AND is_charging = 1 ORDER BY id DESC LIMIT 1;";
-        sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(bat_log_db, sql, -1, &stmt, 0);
-
-        if (rc == SQLITE_OK)
-        {
-
-            sqlite3_bind_text(stmt, 1, device_model, -1, SQLITE_STATIC);
-            rc = sqlite3_step(stmt);
-            if (rc == SQLITE_ROW)
-            {
-
-                sqlite3_stmt *stmt_sum;
-                const char *query_sum = "SELECT SUM(duration) FROM bat_activity WHERE device_serial = ? AND id > ?;";
-                rc = sqlite3_prepare_v2(bat_log_db, query_sum, -1, &stmt_sum, NULL);
-                if (rc == SQLITE_OK)
-                {
-                    sqlite3_bind_text(stmt_sum, 1, device_model, -1, SQLITE_STATIC);
-                    sqlite3_bind_int(stmt_sum, 2, sqlite3_column_int(stmt, 0));
-                    while ((rc = sqlite3_step(stmt_sum)) == SQLITE_ROW)
-                    {
-                        current_session_duration = sqlite3_column_int(stmt_sum, 0);
-                    }
-                }
-                sqlite3_finalize(stmt_sum);
-            }
-        }
-        sqlite3_finalize(stmt);
-    }
-    close_battery_log_db(bat_log_db);
-    
-    return current_session_duration;
+    return running_session;
 }
 
 int set_best_session_time(int best_session)
 {
     int is_success = 0;
 
-    sqlite3* bat_log_db = open_battery_log_db();
-
     if (bat_log_db != NULL)
     {
         const char *sql = "SELECT * FROM device_specifics WHERE device_serial = ? ORDER BY id LIMIT 1;";
@@ -231,19 +247,60 @@ int set_best_session_time(int best_session)
                 }
             }
         }
-        close_battery_log_db(bat_log_db);
     }
 
     return is_success;
 }
 
+static uint64_t monotonic_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+// the battery driver raises a power_supply uevent on plug/unplug and
+// level changes, so we only have to wake up for those
+static int open_uevent_socket(void)
+{
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0)
+        return -1;
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = 1, // kernel broadcast group
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// drains the socket, returns true if any event was about a power supply
+static bool read_power_uevents(int fd)
+{
+    char buf[2048];
+    bool power = false;
+    ssize_t len;
+    while ((len = recv(fd, buf, sizeof(buf) - 1, 0)) > 0) {
+        buf[len] = '\0';
+        // NUL separated KEY=value pairs after the header
+        for (char *line = buf; line < buf + len; line += strlen(line) + 1) {
+            if (!strcmp(line, "SUBSYSTEM=power_supply"))
+                power = true;
+        }
+    }
+    return power;
+}
+
 int main(int argc, char *argv[])
 {
     device_model = PLAT_getModel();
-    sqlite3 *bat_log_db = open_battery_log_db();
+    bat_log_db = open_battery_log_db();
     if(bat_log_db != NULL) {
         best_session_time = get_best_session_time(bat_log_db, device_model);
-        close_battery_log_db(bat_log_db);
+        load_session();
     }
 
     FILE *fp;
@@ -259,9 +316,20 @@ int main(int argc, char *argv[])
     } pwr = {0};
     bool was_charging = false;
 
+    int uevent_fd = open_uevent_socket();
+    // without uevents fall back to polling every second like before
+    int poll_interval_s = uevent_fd >= 0 ? CHECK_BATTERY_TIMEOUT_S : 1;
+    LOG_debug("battery sampling: %s\n", uevent_fd >= 0 ? "uevent" : "poll");
+
+    uint64_t counted_at = monotonic_seconds();
+    uint64_t flushed_at = counted_at;
+    int wakeups = 0;
+
     while (!quit)
     {
-        PLAT_getBatteryStatusFine(&pwr.is_charging, &pwr.charge);
+        // straight from the driver, a shared sample may not have caught up
+        // with the uevent that woke us yet
+        PLAT_getBatteryStatusDirect(&pwr.is_charging, &pwr.charge);
         if (pwr.is_charging)
         {
             if (!was_charging)
@@ -269,7 +337,7 @@ int main(int argc, char *argv[])
                 // Charging just started
                 lowest_percentage_after_charge = 500; // Reset lowest percentage before charge
                 was_charging = true;
-                update_current_duration();
+                flush_samples();
 
                 int session_time = get_current_session_time();
                 LOG_debug("Charging detected - Previous session duration = %d\n", session_time);
@@ -281,6 +349,7 @@ int main(int argc, char *argv[])
                     best_session_time = session_time;
                 }
                 log_new_percentage(pwr.charge, was_charging);
+                flush_samples();
             }
         }
         else if (was_charging)
@@ -295,6 +364,7 @@ int main(int argc, char *argv[])
 
             update_current_duration();
             log_new_percentage(pwr.charge, was_charging);
+            flush_samples();
         }
 
         if (!is_suspended)
@@ -302,10 +372,10 @@ int main(int argc, char *argv[])
             if (ticks >= CHECK_BATTERY_TIMEOUT_S)
             {
                 LOG_debug(
-                    "battery check: suspended = %d, perc = %d\n",
-                    is_suspended, pwr.charge);
+                    "battery check: suspended = %d, perc = %d, wakeups = %d\n",
+                    is_suspended, pwr.charge, wakeups);
 
-                ticks = -1;
+                ticks = 0;
             }
 
             if (pwr.charge != old_percentage)
@@ -331,20 +401,42 @@ int main(int argc, char *argv[])
         }
         else
         {
-            ticks = -1;
+            ticks = 0;
         }
 
-        if (battery_current_state_duration > MAX_DURATION_BEFORE_UPDATE)
-            update_current_duration();
+        uint64_t now = monotonic_seconds();
+        if (now - flushed_at >= FLUSH_INTERVAL_S) {
+            flush_samples();
+            flushed_at = now;
+        }
 
-        sleep(1);
-        battery_current_state_duration++;
-        ticks++;
+        if (flush_and_stop) {
+            // commit before we get frozen for sleep or poweroff
+            flush_and_stop = false;
+            flush_samples();
+            flushed_at = now;
+            raise(SIGSTOP);
+        }
+
+        struct pollfd pfd = {.fd = uevent_fd, .events = POLLIN};
+        if (poll(&pfd, 1, poll_interval_s * 1000) > 0 && (pfd.revents & POLLIN))
+            read_power_uevents(uevent_fd);
+        wakeups++;
+
+        // CLOCK_MONOTONIC stands still while suspended, like the old
+        // one second counter did
+        now = monotonic_seconds();
+        battery_current_state_duration += now - counted_at;
+        ticks += now - counted_at;
+        counted_at = now;
     }
 
     LOG_debug("caught SIGTERM/SIGINT, quitting\n");
 
     // Current battery state duration addition
-    update_current_duration();
+    flush_samples();
+    if (uevent_fd >= 0)
+        close(uevent_fd);
+    close_battery_log_db(bat_log_db);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -279,10 +279,12 @@ void compute_graph(void)
     
     bat_log_db = open_battery_log_db();
     secondsToHoursMinutes(get_best_session_time(bat_log_db, device_model), session_best);
+    secondsToHoursMinutes(get_session_time(bat_log_db, device_model), session_duration);
 
     if (bat_log_db != NULL)
     {
-        const char *sql = "SELECT * FROM bat_activity WHERE device_serial = ? ORDER BY id DESC;";
+        // newest first, stepping stops as soon as the graph is full
+        const char *sql = "SELECT bat_level, duration, is_charging FROM bat_activity WHERE device_serial = ? ORDER BY id DESC;";
         sqlite3_stmt *stmt;
         int rc = sqlite3_prepare_v2(bat_log_db, sql, -1, &stmt, 0);
 
@@ -291,12 +293,12 @@ void compute_graph(void)
             sqlite3_bind_text(stmt, 1, device_model, -1, SQLITE_STATIC);
             bool b_quit = false;
 
-            while ((sqlite3_step(stmt) == SQLITE_ROW) && (!b_quit))
+            while ((!b_quit) && (sqlite3_step(stmt) == SQLITE_ROW))
             {
 
-                int bat_perc = sqlite3_column_int(stmt, 2);
-                int duration = sqlite3_column_int(stmt, 3);
-                bool is_charging = sqlite3_column_int(stmt, 4);
+                int bat_perc = sqlite3_column_int(stmt, 0);
+                int duration = sqlite3_column_int(stmt, 1);
+                bool is_charging = sqlite3_column_int(stmt, 2);
 
                 if (total_duration == 0)
                 {
@@ -323,7 +325,6 @@ void compute_graph(void)
 
                 if ((is_charging) && (!is_estimation_computed))
                 {
-                    secondsToHoursMinutes(total_duration, session_duration);
                     if (previous_index < (graph.layout.graph_max_size - duration_to_pixel(GRAPH_MIN_SESSION_FOR_ESTIMATION)))
                     {
                         float slope = (float)(graph.graphic[graph.layout.graph_max_size - 1].pixel_height - graph.graphic[previous_index].pixel_height) / (float)(graph.layout.graph_max_size - 1 - previous_index);
@@ -1,20 +1,24 @@
 #include "defines.h"
 #include "api.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <math.h>
 #include <msettings.h>
 #include <pthread.h>
 #include <samplerate.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include "utils.h"
 #include "config.h"
@@ -207,6 +211,10 @@ static int _;
 static double current_fps = SCREEN_FPS;
 static int fps_counter = 0;
 double currentfps = 0.0;
+int currentjitterp50 = 0;
+int currentjitterp99 = 0;
+int currentjittermax = 0;
+int currentmissedframes = 0;
 double currentreqfps = 0.0;
 int currentcpuspeed = 0;
 double currentcpuse = 0;
@@ -218,6 +226,10 @@ int currentshaderdstw = 0;
 int currentshaderdsth = 0;
 int currentshadertexw = 0;
 int currentshadertexh = 0;
+int currentuploadus = 0;
+int currenttexcreated = 0; // layer texture pool
+int currenttexuploads = 0;
+int currenttexreused = 0;
 
 int currentbuffersize = 0;
 int currentsampleratein = 0;
@@ -230,10 +242,16 @@ FALLBACK_IMPLEMENTATION void *PLAT_cpu_monitor(void *arg)
 	return NULL;
 }
 
+FALLBACK_IMPLEMENTATION void PLAT_setThreadProfile(int tid, int profile, int cpu) {}
+
 FALLBACK_IMPLEMENTATION void PLAT_getCPUTemp()
 {
 	currentcputemp = 0;
 }
+FALLBACK_IMPLEMENTATION void PLAT_getBatteryStatusDirect(int *is_charging, int *charge)
+{
+	PLAT_getBatteryStatusFine(is_charging, charge);
+}
 
 int GFX_loadSystemFont(const char *fontPath)
 {
@@ -408,18 +426,156 @@ int GFX_hdmiChanged(void)
 	return 1;
 }
 
-#define FRAME_BUDGET 17 // 60fps
-static uint32_t frame_start = 0;
+static uint64_t frame_start = 0; // ns
 
-static uint64_t per_frame_start = 0;
 #define FPS_BUFFER_SIZE 50
 // filling with  60.1 cause i'd rather underrun than overflow in start phase
 static double fps_buffer[FPS_BUFFER_SIZE] = {60.1};
 static int fps_buffer_index = 0;
 
+// frame pacing: waits sleep on an absolute deadline and spin the last
+// stretch, every presented frame is measured against the rate it was
+// meant to run at
+#define JITTER_BUCKET_US 100
+#define JITTER_BUCKETS 64 // last one catches everything above
+#define PACER_SPIN_MIN_NS 100000
+#define PACER_SPIN_MAX_NS 2000000
+#define PACER_MAX_LOST_FRAMES 2
+static struct
+{
+	uint64_t last_swap; // ns
+	uint64_t deadline; // next fixed rate frame, 0 to re-anchor
+	double deadline_fps;
+	int64_t spin_ns; // how early to stop sleeping
+	uint64_t window_start;
+	uint32_t hist[JITTER_BUCKETS];
+	uint32_t count;
+	uint32_t max_us;
+} pacer = {
+	.spin_ns = 500000,
+};
+
+static uint64_t getNanoseconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the spin margin follows twice the typical oversleep so the sleep
+// almost never runs past the deadline on its own
+static void Pacer_waitUntil(uint64_t deadline)
+{
+	uint64_t now = getNanoseconds();
+	if (now >= deadline)
+		return;
+
+	if ((int64_t)(deadline - now) > pacer.spin_ns)
+	{
+		uint64_t wake = deadline - pacer.spin_ns;
+		struct timespec ts = {
+			.tv_sec = wake / 1000000000ULL,
+			.tv_nsec = wake % 1000000000ULL,
+		};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+			;
+		int64_t overshoot = getNanoseconds() - wake;
+		pacer.spin_ns += (overshoot * 2 - pacer.spin_ns) / 8;
+		if (pacer.spin_ns < PACER_SPIN_MIN_NS)
+			pacer.spin_ns = PACER_SPIN_MIN_NS;
+		if (pacer.spin_ns > PACER_SPIN_MAX_NS)
+			pacer.spin_ns = PACER_SPIN_MAX_NS;
+	}
+	while (getNanoseconds() < deadline)
+	{
+		// nothing...
+	}
+}
+
+static uint32_t Pacer_percentile(int pct)
+{
+	uint32_t target = (pacer.count * pct + 99) / 100;
+	uint32_t total = 0;
+	for (int i = 0; i < JITTER_BUCKETS; i++)
+	{
+		total += pacer.hist[i];
+		if (total >= target)
+			return (i + 1) * JITTER_BUCKET_US;
+	}
+	return JITTER_BUCKETS * JITTER_BUCKET_US;
+}
+
+// call right after every present, keeps the averaged fps the audio rate
+// control relies on and the jitter stats shown in the debug HUD
+static void Pacer_trackSwap(double target_fps)
+{
+	uint64_t now = getNanoseconds();
+	uint64_t interval = pacer.last_swap ? now - pacer.last_swap : 0;
+	pacer.last_swap = now;
+	fps_counter++;
+
+	double frame_ns = 1000000000.0 / target_fps;
+	double tempfps = interval ? 1000000000.0 / interval : target_fps;
+	if (tempfps < target_fps * 0.8 || tempfps > target_fps * 1.2)
+		tempfps = target_fps;
+
+	fps_buffer[fps_buffer_index] = tempfps;
+	fps_buffer_index = (fps_buffer_index + 1) % FPS_BUFFER_SIZE;
+	// give it a little bit to stabilize and then use, meanwhile the buffer will
+	// cover it
+	if (fps_counter > 100)
+	{
+		double average_fps = 0.0;
+		int fpsbuffersize = MIN(fps_counter, FPS_BUFFER_SIZE);
+		for (int i = 0; i < fpsbuffersize; i++)
+		{
+			average_fps += fps_buffer[i];
+		}
+		average_fps /= fpsbuffersize;
+		current_fps = average_fps;
+	}
+	else
+	{
+		current_fps = target_fps;
+	}
+	currentfps = current_fps;
+
+	// anything longer is a menu, sleep or load and not worth counting
+	if (interval && interval < frame_ns * 4)
+	{
+		if (interval > frame_ns * 1.5)
+			currentmissedframes += 1;
+
+		uint32_t deviation_us = fabs((double)interval - frame_ns) / 1000;
+		int bucket = deviation_us / JITTER_BUCKET_US;
+		if (bucket >= JITTER_BUCKETS)
+			bucket = JITTER_BUCKETS - 1;
+		pacer.hist[bucket] += 1;
+		pacer.count += 1;
+		if (deviation_us > pacer.max_us)
+			pacer.max_us = deviation_us;
+	}
+
+	if (!pacer.window_start)
+		pacer.window_start = now;
+	if (now - pacer.window_start >= 1000000000ULL)
+	{
+		pacer.window_start = now;
+		if (pacer.count)
+		{
+			currentjitterp50 = Pacer_percentile(50);
+			currentjitterp99 = Pacer_percentile(99);
+			currentjittermax = pacer.max_us;
+		}
+		memset(pacer.hist, 0, sizeof(pacer.hist));
+		pacer.count = 0;
+		pacer.max_us = 0;
+	}
+}
+
 void GFX_startFrame(void)
 {
-	frame_start = SDL_GetTicks();
+	frame_start = getNanoseconds();
 }
 
 void chmodfile(const char *file, int writable)
@@ -558,88 +714,31 @@ void GFX_setAmbientColor(const void *data, unsigned width, unsigned height, size
 
 void GFX_flip(SDL_Surface *screen)
 {
-
 	PLAT_flip(screen, 0);
-
-	currentfps = current_fps;
-	fps_counter++;
-
-	uint64_t performance_frequency = SDL_GetPerformanceFrequency();
-	uint64_t frame_duration = SDL_GetPerformanceCounter() - per_frame_start;
-	double elapsed_time_s = (double)frame_duration / performance_frequency;
-	double tempfps = 1.0 / elapsed_time_s;
-
-	if (tempfps < SCREEN_FPS * 0.8 || tempfps > SCREEN_FPS * 1.2)
-		tempfps = SCREEN_FPS;
-
-	fps_buffer[fps_buffer_index] = tempfps;
-	fps_buffer_index = (fps_buffer_index + 1) % FPS_BUFFER_SIZE;
-	// give it a little bit to stabilize and then use, meanwhile the buffer will
-	// cover it
-	if (fps_counter > 100)
-	{
-		double average_fps = 0.0;
-		int fpsbuffersize = MIN(fps_counter, FPS_BUFFER_SIZE);
-		for (int i = 0; i < fpsbuffersize; i++)
-		{
-			average_fps += fps_buffer[i];
-		}
-		average_fps /= fpsbuffersize;
-		current_fps = average_fps;
-	}
-
-	per_frame_start = SDL_GetPerformanceCounter();
+	Pacer_trackSwap(SCREEN_FPS);
 }
 void GFX_GL_Swap()
 {
-
 	PLAT_GL_Swap();
-
-	currentfps = current_fps;
-	fps_counter++;
-
-	uint64_t performance_frequency = SDL_GetPerformanceFrequency();
-	uint64_t frame_duration = SDL_GetPerformanceCounter() - per_frame_start;
-	double elapsed_time_s = (double)frame_duration / performance_frequency;
-	double tempfps = 1.0 / elapsed_time_s;
-
-	if (tempfps < SCREEN_FPS * 0.8 || tempfps > SCREEN_FPS * 1.2)
-		tempfps = SCREEN_FPS;
-
-	fps_buffer[fps_buffer_index] = tempfps;
-	fps_buffer_index = (fps_buffer_index + 1) % FPS_BUFFER_SIZE;
-	// give it a little bit to stabilize and then use, meanwhile the buffer will
-	// cover it
-	if (fps_counter > 100)
-	{
-		double average_fps = 0.0;
-		int fpsbuffersize = MIN(fps_counter, FPS_BUFFER_SIZE);
-		for (int i = 0; i < fpsbuffersize; i++)
-		{
-			average_fps += fps_buffer[i];
-		}
-		average_fps /= fpsbuffersize;
-		current_fps = average_fps;
-	}
-
-	per_frame_start = SDL_GetPerformanceCounter();
+	Pacer_trackSwap(SCREEN_FPS);
 }
 // eventually this function should be removed as its only here because of all the audio buffer based delay stuff
 void GFX_sync(void)
 {
-	uint32_t frame_duration = SDL_GetTicks() - frame_start;
+	uint64_t budget = 1000000000.0 / SCREEN_FPS;
+	uint64_t frame_duration = getNanoseconds() - frame_start;
 	if (gfx.vsync != VSYNC_OFF)
 	{
 		// this limiting condition helps SuperFX chip games
-		if (gfx.vsync == VSYNC_STRICT || frame_start == 0 || frame_duration < FRAME_BUDGET)
+		if (gfx.vsync == VSYNC_STRICT || frame_start == 0 || frame_duration < budget)
 		{ // only wait if we're under frame budget
-			PLAT_vsync(FRAME_BUDGET - frame_duration);
+			int remaining = frame_duration < budget ? (budget - frame_duration) / 1000000 : 0;
+			PLAT_vsync(remaining);
 		}
 	}
 	else
 	{
-		if (frame_duration < FRAME_BUDGET)
-			SDL_Delay(FRAME_BUDGET - frame_duration);
+		Pacer_waitUntil(frame_start + budget);
 	}
 }
 
@@ -647,108 +746,46 @@ void GFX_flip_fixed_rate(SDL_Surface *screen, double target_fps)
 {
 	if (target_fps == 0.0)
 		target_fps = SCREEN_FPS;
-	double frame_budget_ms = 1000.0 / target_fps;
 
-	static int64_t frame_index = -1;
-	static int64_t first_frame_start_time = 0;
-	static double last_target_fps = 0.0;
+	uint64_t frame_duration = 1000000000.0 / target_fps;
+	uint64_t now = getNanoseconds();
 
-	int64_t perf_freq = SDL_GetPerformanceFrequency();
-	int64_t now = SDL_GetPerformanceCounter();
-
-	if (++frame_index == 0 || target_fps != last_target_fps)
+	// the schedule is a chain of absolute deadlines so rounding never
+	// accumulates, it only re-anchors after a rate change or when it
+	// has fallen too far behind to catch up without a burst of frames
+	if (!pacer.deadline || target_fps != pacer.deadline_fps)
 	{
-		frame_index = 0;
-		first_frame_start_time = now;
-		last_target_fps = target_fps;
+		pacer.deadline = now;
+		pacer.deadline_fps = target_fps;
 	}
-
-	int64_t frame_duration = perf_freq / target_fps;
-	int64_t time_of_frame = first_frame_start_time + frame_index * frame_duration;
-	int64_t offset = now - time_of_frame;
-	const int max_lost_frames = 2;
-
-	// printf("%s: frame #%lld, time is %lld, scheduled at %lld, offset is %lld\n",
-	// 	__FUNCTION__,
-	// 	frame_index,
-	// 	now,
-	// 	time_of_frame,
-	// 	now - time_of_frame);
-
-	if (offset > 0)
+	else if (now > pacer.deadline + PACER_MAX_LOST_FRAMES * frame_duration)
 	{
-		if (offset > max_lost_frames * frame_duration)
-		{
-			frame_index = -1;
-			last_target_fps = 0.0;
-			LOG_debug("%s: lost sync by more than %d frames (late) @%llu -> reset\n\n", __FUNCTION__, max_lost_frames, SDL_GetPerformanceCounter());
-		}
+		LOG_debug("%s: lost sync by more than %d frames (late) -> re-anchor\n", __FUNCTION__, PACER_MAX_LOST_FRAMES);
+		pacer.deadline = now;
 	}
-	else
-	{
-		if (offset < -max_lost_frames * frame_duration)
-		{
-			frame_index = -1;
-			last_target_fps = 0.0;
-			LOG_debug("%s: lost sync by more than %d frames (early ?!) @%llu -> reset\n\n", __FUNCTION__, max_lost_frames, SDL_GetPerformanceCounter());
-		}
-		else if (offset < 0)
-		{
-			useconds_t time_to_sleep_us = (useconds_t)((time_of_frame - now) * 1e6 / perf_freq);
 
-			// The OS scheduling algorithm cannot guarantee that
-			// the sleep will last the exact amount of requested time.
-			// We sleep as much as we can using the OS primitive.
-			const useconds_t min_waiting_time = 2000;
-			if (time_to_sleep_us > min_waiting_time)
-			{
-				usleep(time_to_sleep_us - min_waiting_time);
-			}
+	Pacer_waitUntil(pacer.deadline);
+	pacer.deadline += frame_duration;
 
-			while (SDL_GetPerformanceCounter() < time_of_frame)
-			{
-				// nothing...
-			}
-		}
-	}
 	// PLAT_flip(screen, 0);
 	PLAT_GL_Swap();
-
-	double elapsed_time_s = (double)(SDL_GetPerformanceCounter() - per_frame_start) / perf_freq;
-	double tempfps = 1.0 / elapsed_time_s;
-
-	fps_buffer[fps_buffer_index] = tempfps;
-	fps_buffer_index = (fps_buffer_index + 1) % FPS_BUFFER_SIZE;
-	// give it a little bit to stabilize and then use, meanwhile the buffer will
-	// cover it
-	if (fps_counter++ > 100)
-	{
-		double average_fps = 0.0;
-		int fpsbuffersize = MIN(fps_counter, FPS_BUFFER_SIZE);
-		for (int i = 0; i < fpsbuffersize; i++)
-		{
-			average_fps += fps_buffer[i];
-		}
-		average_fps /= fpsbuffersize;
-		currentfps = current_fps = average_fps;
-	}
-	else
-	{
-		currentfps = current_fps = target_fps;
-	}
-	per_frame_start = SDL_GetPerformanceCounter();
+	Pacer_trackSwap(target_fps);
 }
 
 // if a fake vsycn delay is really needed
 void GFX_delay(void)
 {
-	uint32_t frame_duration = SDL_GetTicks() - frame_start;
-	if (frame_duration < ((1 / SCREEN_FPS) * 1000))
-		SDL_Delay(((1 / SCREEN_FPS) * 1000) - frame_duration);
+	Pacer_waitUntil(frame_start + (uint64_t)(1000000000.0 / SCREEN_FPS));
 }
 
 FALLBACK_IMPLEMENTATION int PLAT_supportsOverscan(void) { return 0; }
 FALLBACK_IMPLEMENTATION void PLAT_setEffectColor(int next_color) {}
+FALLBACK_IMPLEMENTATION int PLAT_warmShaderCache(void) { return 0; }
+FALLBACK_IMPLEMENTATION void PLAT_setStreamUpload(int enable) {}
+FALLBACK_IMPLEMENTATION int PLAT_GL_screenCaptureAsync(void) { return 0; }
+FALLBACK_IMPLEMENTATION unsigned char* PLAT_GL_screenCaptureCollect(int* outWidth, int* outHeight, int wait) { return NULL; }
+FALLBACK_IMPLEMENTATION void PLAT_GL_setCurrent(int current) {}
+FALLBACK_IMPLEMENTATION void PLAT_GL_setTransition(int type, float progress) {}
 
 int GFX_truncateText(TTF_Font *font, const char *in_name, char *out_name, int max_width, int padding)
 {
@@ -860,6 +897,122 @@ int GFX_wrapText(TTF_Font *font, char *str, int max_width, int max_lines)
 
 ///////////////////////////////
 
+// layer drawing and the animate helpers borrow their textures from a small
+// pool instead of creating one per call. textures are bucketed by their
+// exact size, rounding up would let linear filtering pick up whatever is
+// left past the edge, and each one remembers a hash of what it last
+// uploaded so drawing an unchanged surface skips the upload entirely
+#define TEXPOOL_SIZE 12
+static struct {
+	PooledTexture entries[TEXPOOL_SIZE];
+	uint32_t clock;
+} texpool;
+
+static uint64_t TexPool_hash(SDL_Surface* surface) {
+	// four lanes so the multiplies don't wait on each other
+	uint64_t h[4] = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL, 0x9ce484222325cbf2ULL, 0x2325cbf29ce48422ULL };
+	const int row = surface->w * surface->format->BytesPerPixel;
+	for (int y = 0; y < surface->h; y++) {
+		const uint8_t* p = (const uint8_t*)surface->pixels + (size_t)y * surface->pitch;
+		int x = 0;
+		for (; x + 32 <= row; x += 32) {
+			uint64_t v[4];
+			memcpy(v, p + x, sizeof(v));
+			for (int i = 0; i < 4; i++) h[i] = (h[i] ^ v[i]) * 0x100000001b3ULL;
+		}
+		for (; x < row; x++) h[0] = (h[0] ^ p[x]) * 0x100000001b3ULL;
+	}
+	uint64_t key = h[0] ^ (h[1] * 3) ^ (h[2] * 5) ^ (h[3] * 7) ^ ((uint64_t)surface->w << 32 | surface->h);
+	return key ? key : 1;
+}
+
+PooledTexture* TexPool_acquire(SDL_Renderer* renderer, SDL_Surface* surface) {
+	SDL_Surface* converted = NULL;
+	if (surface->format->format != SDL_PIXELFORMAT_RGBA8888) {
+		converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA8888, 0);
+		if (!converted) return NULL;
+		surface = converted;
+	}
+	uint64_t key = TexPool_hash(surface);
+
+	PooledTexture* match = NULL;
+	PooledTexture* same_size = NULL;
+	PooledTexture* empty = NULL;
+	PooledTexture* oldest = NULL;
+	for (int i = 0; i < TEXPOOL_SIZE; i++) {
+		PooledTexture* entry = &texpool.entries[i];
+		if (entry->busy) continue;
+		if (!entry->texture) {
+			if (!empty) empty = entry;
+			continue;
+		}
+		if (entry->w == surface->w && entry->h == surface->h) {
+			if (entry->key == key) {
+				match = entry;
+				break;
+			}
+			if (!same_size || entry->used < same_size->used) same_size = entry;
+		}
+		if (!oldest || entry->used < oldest->used) oldest = entry;
+	}
+
+	PooledTexture* entry = match ? match : same_size;
+	if (!entry) {
+		entry = empty ? empty : oldest;
+		if (!entry) {
+			printf("Texture pool exhausted\n");
+			if (converted) SDL_FreeSurface(converted);
+			return NULL;
+		}
+		if (entry->texture) SDL_DestroyTexture(entry->texture);
+		entry->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, surface->w, surface->h);
+		if (!entry->texture) {
+			printf("Failed to create pooled texture: %s\n", SDL_GetError());
+			if (converted) SDL_FreeSurface(converted);
+			return NULL;
+		}
+		entry->w = surface->w;
+		entry->h = surface->h;
+		entry->key = 0;
+		currenttexcreated += 1;
+	}
+
+	if (entry->key == key) {
+		currenttexreused += 1;
+	}
+	else {
+		SDL_UpdateTexture(entry->texture, NULL, surface->pixels, surface->pitch);
+		entry->key = key;
+		currenttexuploads += 1;
+	}
+	if (converted) SDL_FreeSurface(converted);
+
+	// state left behind by the previous user, back to what a fresh
+	// RGBA8888 texture starts with. callers that want another mode set it
+	SDL_SetTextureBlendMode(entry->texture, SDL_BLENDMODE_BLEND);
+	SDL_SetTextureColorMod(entry->texture, 255, 255, 255);
+	SDL_SetTextureAlphaMod(entry->texture, 255);
+
+	entry->busy = 1;
+	entry->used = ++texpool.clock;
+	return entry;
+}
+
+void TexPool_release(PooledTexture* entry) {
+	if (entry) entry->busy = 0;
+}
+
+void TexPool_quit(void) {
+	for (int i = 0; i < TEXPOOL_SIZE; i++) {
+		PooledTexture* entry = &texpool.entries[i];
+		if (entry->texture) SDL_DestroyTexture(entry->texture);
+		*entry = (PooledTexture){0};
+	}
+	LOG_info("texture pool: %i created, %i uploads, %i reused\n", currenttexcreated, currenttexuploads, currenttexreused);
+}
+
+///////////////////////////////
+
 // scale_blend (and supporting logic) from picoarch
 
 struct blend_args
@@ -2121,6 +2274,12 @@ pthread_mutex_t audio_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void SND_audioCallback(void *userdata, uint8_t *stream, int len)
 {
+	static __thread int registered = 0; // SDL starts a new thread for every device
+	if (!registered)
+	{
+		registered = 1;
+		PWR_registerThread(THREAD_PROFILE_AUDIO);
+	}
 	if (snd.frame_count == 0)
 		return;
 	if (!snd.initialized)
@@ -2801,12 +2960,15 @@ void PAD_reset(void)
 	pad.just_released = BTN_NONE;
 	pad.just_repeated = BTN_NONE;
 }
+FALLBACK_IMPLEMENTATION void PLAT_setInputTimestamps(int enable) {}
+FALLBACK_IMPLEMENTATION uint64_t PLAT_getInputTimestamp(void) { return 0; }
 FALLBACK_IMPLEMENTATION void PLAT_pollInput(void)
 {
 	// reset transient state
 	pad.just_pressed = BTN_NONE;
 	pad.just_released = BTN_NONE;
 	pad.just_repeated = BTN_NONE;
+	pad.pressed_at = 0;
 
 	uint32_t tick = SDL_GetTicks();
 	for (int i = 0; i < BTN_ID_COUNT; i++)
@@ -3218,6 +3380,16 @@ FALLBACK_IMPLEMENTATION void PLAT_pollInput(void)
 
 	if (lid.has_lid && PLAT_lidChanged(NULL))
 		pad.just_released |= BTN_SLEEP;
+
+	// SDL drops the kernel timestamp, ask the platform for it and
+	// fall back to poll time which underestimates by up to a frame
+	if (pad.just_pressed)
+	{
+		uint64_t now = getMicroseconds();
+		pad.pressed_at = PLAT_getInputTimestamp();
+		if (!pad.pressed_at || now - pad.pressed_at > 250000) // none or stale
+			pad.pressed_at = now;
+	}
 }
 FALLBACK_IMPLEMENTATION int PLAT_shouldWake(void)
 {
@@ -3328,6 +3500,7 @@ static void *VIB_thread(void *arg)
 {
 #define DEFER_FRAMES 3
 	static int defer = 0;
+	PWR_registerThread(THREAD_PROFILE_BACKGROUND);
 	while (1)
 	{
 		SDL_Delay(17);
@@ -3456,6 +3629,7 @@ void PWR_updateFrequency(int secs, int updateWifi)
 
 static void *PWR_monitorBattery(void *arg)
 {
+	PWR_registerThread(THREAD_PROFILE_BACKGROUND);
 	while (1)
 	{
 		struct PWR_Context *pwr_ctx = (struct PWR_Context *)arg;
@@ -3525,9 +3699,13 @@ void PWR_update(int *_dirty, int *_show_setting, PWR_callback_t before_sleep, PW
 	static uint32_t power_pressed_at = 0;  // timestamp when power button was just pressed
 	static uint32_t mod_unpressed_at = 0;  // timestamp of last time settings modifier key was NOT down
 	static uint32_t was_muted = -1;
+	static unsigned int settings_generation = 0; // last one the hud was drawn with
 	if (was_muted == -1 && InitializedSettings())
 		was_muted = GetMute();
 
+	int shown_setting = show_setting;
+	int settings_changed = 0;
+
 	static int was_charging = -1;
 	if (was_charging == -1) was_charging = pwr.is_charging;
 
@@ -3535,6 +3713,8 @@ void PWR_update(int *_dirty, int *_show_setting, PWR_callback_t before_sleep, PW
 	if (was_charging || PAD_anyPressed() || last_input_at == 0)
 		last_input_at = now;
 
+	CFG_poll();
+
 #define CHARGE_DELAY 1000
 	if (dirty || now - checked_charge_at >= CHARGE_DELAY)
 	{
@@ -3630,6 +3810,10 @@ void PWR_update(int *_dirty, int *_show_setting, PWR_callback_t before_sleep, PW
 
 	if (InitializedSettings())
 	{
+		unsigned int generation = GetSettingsGeneration();
+		settings_changed = generation != settings_generation;
+		settings_generation = generation;
+
 		int muted = GetMute();
 		if (muted != was_muted)
 		{
@@ -3641,8 +3825,10 @@ void PWR_update(int *_dirty, int *_show_setting, PWR_callback_t before_sleep, PW
 
 	LEDS_applyRules();
 
-	if (show_setting)
-		dirty = 1; // shm is slow or keymon is catching input on the next frame
+	// keymon applies the press a frame or so after we see it, the
+	// generation bump is what tells us the hud has a new value to show
+	if (show_setting && (show_setting != shown_setting || settings_changed))
+		dirty = 1;
 	if (_dirty)
 		*_dirty = dirty;
 	if (_show_setting)
@@ -3663,6 +3849,77 @@ void PWR_disablePowerOff(void)
 {
 	pwr.can_poweroff = 0;
 }
+// /proc/<pid>/stat state letter, 0 once the process is gone
+static char PWR_processState(pid_t pid)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%i/stat", pid);
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return 0;
+	char state = 0;
+	if (fscanf(file, "%*d (%*[^)]) %c", &state) != 1)
+		state = 0;
+	fclose(file);
+	return state;
+}
+
+static pid_t PWR_findProcess(const char *name)
+{
+	DIR *dir = opendir("/proc");
+	if (!dir)
+		return 0;
+	pid_t pid = 0;
+	struct dirent *dp;
+	while (!pid && (dp = readdir(dir)))
+	{
+		if (dp->d_name[0] < '1' || dp->d_name[0] > '9')
+			continue;
+		char path[64];
+		char comm[32] = {0};
+		snprintf(path, sizeof(path), "/proc/%s/comm", dp->d_name);
+		FILE *file = fopen(path, "r"); // procfs reports a size of 0, so no getFile()
+		if (!file)
+			continue;
+		if (!fgets(comm, sizeof(comm), file))
+			comm[0] = '\0';
+		fclose(file);
+		comm[strcspn(comm, "\n")] = '\0';
+		if (exactMatch(comm, name))
+			pid = atoi(dp->d_name);
+	}
+	closedir(dir);
+	return pid;
+}
+
+// batmon commits its buffered log on USR1 and then stops itself. sleep and
+// poweroff must not start before that commit is done, so wait for it to
+// reach the stopped state, only freezing it outright if it never gets there
+#define BATMON_STOP_TIMEOUT_MS 2000
+static void PWR_stopBatmon(void)
+{
+	pid_t pid = PWR_findProcess("batmon.elf");
+	if (!pid)
+		return;
+	char state = PWR_processState(pid);
+	if (state == 'T' || state == 't' || !state)
+		return; // already frozen, a queued USR1 would stop it again right after CONT
+
+	kill(pid, SIGUSR1);
+	uint32_t start = SDL_GetTicks();
+	while ((state = PWR_processState(pid)) && state != 'T' && state != 't')
+	{
+		if (SDL_GetTicks() - start >= BATMON_STOP_TIMEOUT_MS)
+		{
+			LOG_warn("batmon didn't stop after %ims, freezing it\n", BATMON_STOP_TIMEOUT_MS);
+			kill(pid, SIGSTOP);
+			return;
+		}
+		SDL_Delay(10);
+	}
+	LOG_debug("batmon stopped after %ims\n", SDL_GetTicks() - start);
+}
+
 void PWR_powerOff(int reboot)
 {
 	if (pwr.can_poweroff)
@@ -3703,8 +3960,10 @@ void PWR_powerOff(int reboot)
 		GFX_blitMessage(font.large, msg, gfx.screen, &(SDL_Rect){0, 0, gfx.screen->w, gfx.screen->h}); //, NULL);
 		GFX_flip(gfx.screen);
 
+		CFG_flush();
+
 		system("killall -STOP keymon.elf");
-		system("killall -STOP batmon.elf");
+		PWR_stopBatmon();
 		system("killall -STOP wifi_daemon");
 		system("killall -STOP audiomon.elf");
 
@@ -3716,6 +3975,7 @@ void PWR_powerOff(int reboot)
 
 static void PWR_enterSleep(void)
 {
+	CFG_flush();
 	SND_pauseAudio(true);
 	LEDS_pushProfileOverride(LIGHT_PROFILE_SLEEP);
 	if (GetHDMI())
@@ -3733,7 +3993,7 @@ static void PWR_enterSleep(void)
 		PLAT_enableBacklight(0);
 	}
 	system("killall -STOP keymon.elf");
-	system("killall -STOP batmon.elf");
+	PWR_stopBatmon();
 	// this is currently handled in wifi_init.sh from suspend script, doing this double or at same time causes problems
 	// system("killall -STOP wifi_daemon");
 	system("killall -STOP audiomon.elf");
@@ -3869,6 +4129,85 @@ int PWR_deepSleep(void)
 	return PLAT_deepSleep();
 }
 
+///////////////////////////////
+
+#define MAX_PROFILED_THREADS 16
+static struct
+{
+	pthread_mutex_t lock;
+	int cpu; // dedicated to emulation, 0 when off
+	int count;
+	struct
+	{
+		int tid;
+		int profile;
+	} threads[MAX_PROFILED_THREADS];
+} profiled = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+void PWR_registerThread(int profile)
+{
+	int tid = syscall(SYS_gettid);
+	pthread_mutex_lock(&profiled.lock);
+	int i;
+	for (i = 0; i < profiled.count; i++)
+	{
+		// only background threads come in numbers, a new emulation,
+		// audio or render thread takes over its predecessor's entry
+		if (profiled.threads[i].tid == tid || (profile != THREAD_PROFILE_BACKGROUND && profiled.threads[i].profile == profile))
+			break;
+	}
+	if (i == profiled.count)
+	{
+		if (profiled.count == MAX_PROFILED_THREADS)
+		{
+			pthread_mutex_unlock(&profiled.lock);
+			LOG_warn("PWR_registerThread: no room for thread %i\n", tid);
+			return;
+		}
+		profiled.count += 1;
+	}
+	profiled.threads[i].tid = tid;
+	profiled.threads[i].profile = profile;
+	if (profiled.cpu)
+		PLAT_setThreadProfile(tid, profile, profiled.cpu);
+	pthread_mutex_unlock(&profiled.lock);
+}
+
+void PWR_unregisterThread(void)
+{
+	int tid = syscall(SYS_gettid);
+	pthread_mutex_lock(&profiled.lock);
+	for (int i = 0; i < profiled.count; i++)
+	{
+		if (profiled.threads[i].tid != tid)
+			continue;
+		profiled.count -= 1;
+		profiled.threads[i] = profiled.threads[profiled.count];
+		break;
+	}
+	pthread_mutex_unlock(&profiled.lock);
+}
+
+void PWR_setThreadPinning(int cpu)
+{
+	pthread_mutex_lock(&profiled.lock);
+	if (cpu != profiled.cpu)
+	{
+		profiled.cpu = cpu;
+		for (int i = 0; i < profiled.count; i++)
+		{
+			PLAT_setThreadProfile(profiled.threads[i].tid, cpu ? profiled.threads[i].profile : THREAD_PROFILE_DEFAULT, cpu);
+		}
+		if (cpu)
+			LOG_info("thread pinning: emulation on cpu%i (%i threads)\n", cpu, profiled.count);
+		else
+			LOG_info("thread pinning: off\n");
+	}
+	pthread_mutex_unlock(&profiled.lock);
+}
+
 void PWR_disableAutosleep(void)
 {
 	pwr.can_autosleep = 0;
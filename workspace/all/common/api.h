@@ -85,6 +85,10 @@ extern int avgbufferfree;
 extern int currentbuffertarget;
 extern int currentframecount;
 extern double currentfps;
+extern int currentjitterp50; // us, deviation from the target frame time over the last second
+extern int currentjitterp99;
+extern int currentjittermax;
+extern int currentmissedframes; // presents that came more than half a frame late
 extern double currentreqfps;
 extern float currentbufferms;
 extern int currentbuffersize;
@@ -98,6 +102,10 @@ extern int currentshaderdstw;
 extern int currentshaderdsth;
 extern int currentshadertexw;
 extern int currentshadertexh;
+extern int currentuploadus;
+extern int currenttexcreated;
+extern int currenttexuploads;
+extern int currenttexreused;
 extern double currentcpuse;
 extern int currentcputemp;
 extern int should_rotate;
@@ -178,6 +186,13 @@ enum {
 	EFFECT_COUNT,
 };
 
+enum {
+	TRANSITION_NONE,
+	TRANSITION_FADE,
+	TRANSITION_ZOOM_FADE,
+	TRANSITION_CIRCLE,
+};
+
 typedef struct GFX_Renderer {
 	void* src;
 	void* dst;
@@ -252,6 +267,7 @@ SDL_Surface* GFX_init(int mode);
 #define GFX_resize PLAT_resizeVideo				// (int w, int h, int pitch);
 #define GFX_setSharpness PLAT_setSharpness // (int sharpness)
 #define GFX_setEffectColor PLAT_setEffectColor // (int color)
+#define GFX_setStreamUpload PLAT_setStreamUpload // (int enable)
 #define GFX_setEffect PLAT_setEffect // (int effect)
 #define GFX_setOverlay PLAT_setOverlay// (int effect)
 #define GFX_setOffsetX PLAT_setOffsetX// (int effect)
@@ -266,6 +282,10 @@ SDL_Surface* GFX_init(int mode);
 #define GFX_scrollTextTexture PLAT_scrollTextTexture
 #define GFX_flipHidden PLAT_flipHidden //(void)
 #define GFX_GL_screenCapture PLAT_GL_screenCapture //(void)
+#define GFX_GL_screenCaptureAsync PLAT_GL_screenCaptureAsync // int:(void) starts a non-blocking capture, 0 if unsupported or busy
+#define GFX_GL_screenCaptureCollect PLAT_GL_screenCaptureCollect // unsigned char*:(int* w, int* h, int wait) NULL until ready
+#define GFX_GL_setCurrent PLAT_GL_setCurrent // void:(int current) binds or releases the GL context on the calling thread
+#define GFX_GL_setTransition PLAT_GL_setTransition // void:(int type, float progress) drawn over the next swaps, 0 is black and 1 is done
 
 void GFX_setMode(int mode);
 int GFX_hdmiChanged(void);
@@ -299,6 +319,19 @@ int GFX_getTextWidth(TTF_Font* font, const char* in_name, char* out_name, int ma
 int GFX_getTextHeight(TTF_Font* font, const char* in_name, char* out_name, int max_width, int padding); // returns final width
 int GFX_wrapText(TTF_Font* font, char* str, int max_width, int max_lines);
 
+// textures the platform's layer and animate helpers borrow, see api.c
+typedef struct PooledTexture {
+	SDL_Texture* texture;
+	int w;
+	int h;
+	int busy;
+	uint64_t key; // content of the last upload
+	uint32_t used; // for eviction
+} PooledTexture;
+PooledTexture* TexPool_acquire(SDL_Renderer* renderer, SDL_Surface* surface); // uploads only if the content changed, NULL on failure
+void TexPool_release(PooledTexture* entry);
+void TexPool_quit(void); // call before destroying the renderer
+
 #define GFX_getScaler PLAT_getScaler		// scaler_t:(GFX_Renderer* renderer)
 #define GFX_blitRenderer PLAT_blitRenderer	// void:(GFX_Renderer* renderer)
 #define GFX_setShaders PLAT_setShaders	// void:(GFX_Renderer* renderer)
@@ -306,6 +339,7 @@ int GFX_wrapText(TTF_Font* font, char* str, int max_width, int max_lines);
 #define GFX_clearShaders PLAT_clearShaders	// void:(GFX_Renderer* renderer)
 #define GFX_updateShader PLAT_updateShader	// void:(GFX_Renderer* renderer)
 #define GFX_initShaders PLAT_initShaders	// void:(GFX_Renderer* renderer)
+#define GFX_warmShaderCache PLAT_warmShaderCache	// int:(void) checks or compiles one shader per call, returns 0 when done
 
 scaler_t GFX_getAAScaler(GFX_Renderer* renderer);
 void GFX_freeAAScaler(void);
@@ -409,6 +443,7 @@ typedef struct PAD_Context {
 	uint32_t repeat_at[BTN_ID_COUNT];
 	PAD_Axis laxis;
 	PAD_Axis raxis;
+	uint64_t pressed_at; // getMicroseconds() of the newest press this poll, 0 if none
 } PAD_Context;
 extern PAD_Context pad;
 
@@ -420,6 +455,7 @@ extern PAD_Context pad;
 #define PAD_update PLAT_updateInput
 #define PAD_poll PLAT_pollInput
 #define PAD_wake PLAT_shouldWake
+#define PAD_setTimestamps PLAT_setInputTimestamps // (int enable) kernel press timestamps for latency probing
 
 void PAD_setAnalog(int neg, int pos, int value, int repeat_at); // internal
 
@@ -533,6 +569,19 @@ enum {
 #define CPU_SWITCH_DELAY_MS 500
 #define PWR_setCPUSpeed PLAT_setCPUSpeed
 
+// threads register the role they play once, the profiles only take effect
+// while a core is dedicated to emulation with PWR_setThreadPinning()
+enum {
+	THREAD_PROFILE_DEFAULT,
+	THREAD_PROFILE_EMULATION, // alone on the dedicated core
+	THREAD_PROFILE_AUDIO, // SCHED_FIFO, off the dedicated core
+	THREAD_PROFILE_RENDER, // off the dedicated core
+	THREAD_PROFILE_BACKGROUND, // off the dedicated core, niced
+};
+void PWR_registerThread(int profile); // enum, applies to the calling thread
+void PWR_unregisterThread(void); // before a registered thread exits
+void PWR_setThreadPinning(int cpu); // 0 restores normal scheduling
+
 ///////////////////////////////
 
 FILE *PLAT_OpenSettings(const char *filename);
@@ -544,6 +593,8 @@ void PLAT_quitInput(void);
 
 void PLAT_pollInput(void);
 int PLAT_shouldWake(void);
+void PLAT_setInputTimestamps(int enable);
+uint64_t PLAT_getInputTimestamp(void);
 
 SDL_Surface* PLAT_initVideo(void);
 void PLAT_quitVideo(void);
@@ -554,6 +605,7 @@ void PLAT_setVsync(int vsync);
 SDL_Surface* PLAT_resizeVideo(int w, int h, int pitch);
 void PLAT_setSharpness(int sharpness);
 void PLAT_setEffectColor(int color);
+void PLAT_setStreamUpload(int enable);
 void PLAT_setEffect(int effect);
 void PLAT_setOverlay(const char* filename, const char* tag);
 void PLAT_setOffsetX(int x);
@@ -598,6 +650,10 @@ void PLAT_flip(SDL_Surface* screen, int sync);
 void PLAT_GL_Swap();
 void GFX_GL_Swap();
 unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight);
+int PLAT_GL_screenCaptureAsync(void);
+unsigned char* PLAT_GL_screenCaptureCollect(int* outWidth, int* outHeight, int wait);
+void PLAT_GL_setCurrent(int current);
+void PLAT_GL_setTransition(int type, float progress);
 unsigned char* PLAT_pixelscaler(const unsigned char* src, int sw, int sh, int scale, int* outW, int* outH);
 void PLAT_GPU_Flip();
 void PLAT_setShaders(int nr);
@@ -614,6 +670,7 @@ void PLAT_setShader2(const char* filename);
 void PLAT_setShader3(const char* filename);
 void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int *scaletype, int *inputtype);
 void PLAT_initShaders();
+int PLAT_warmShaderCache(void);
 ShaderParam* PLAT_getShaderPragmas(int i);
 int PLAT_supportsOverscan(void);
 
@@ -624,6 +681,7 @@ void PLAT_enableOverlay(int enable);
 #define PWR_LOW_CHARGE 10
 void PLAT_getBatteryStatus(int* is_charging, int* charge); // 0,1 and 0,10,20,40,60,80,100
 void PLAT_getBatteryStatusFine(int* is_charging, int* charge); // 0,1 and 0-100
+void PLAT_getBatteryStatusDirect(int* is_charging, int* charge); // same, but never from a cached sample
 void PLAT_enableBacklight(int enable);
 int PLAT_supportsDeepSleep(void);
 int PLAT_deepSleep(void);
@@ -631,6 +689,7 @@ void PLAT_powerOff(int reboot);
 
 void *PLAT_cpu_monitor(void *arg);
 void PLAT_setCPUSpeed(int speed); // enum
+void PLAT_setThreadProfile(int tid, int profile, int cpu); // enum, cpu 0 means no pinning
 void PLAT_setCustomCPUSpeed(int speed);
 void PLAT_setRumble(int strength);
 int PLAT_pickSampleRate(int requested, int max);
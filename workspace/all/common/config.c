@@ -1,6 +1,7 @@
 #include "config.h"
 #include "defines.h"
 #include "utils.h"
+#include <unistd.h>
 
 NextUISettings settings = {0};
 
@@ -71,12 +72,217 @@ void CFG_defaults(NextUISettings *cfg)
     *cfg = defaults;
 }
 
+// Setters only mark the store dirty; the file is rewritten once the
+// settings have been left alone for CFG_SYNC_DELAY_MS (see CFG_poll), or
+// right away on sleep, power off and exit.
+#define CFG_SYNC_DELAY_MS 1000
+
+static bool cfg_loading = false;
+static bool cfg_dirty = false;
+static uint64_t cfg_dirty_at = 0;
+static int cfg_writes = 0;
+
+static void CFG_markDirty(void)
+{
+    if (cfg_loading)
+        return;
+    cfg_dirty = true;
+    cfg_dirty_at = getMicroseconds();
+}
+
+void CFG_poll(void)
+{
+    if (cfg_dirty && getMicroseconds() - cfg_dirty_at >= CFG_SYNC_DELAY_MS * 1000ULL)
+        CFG_sync();
+}
+
+// minuisettings.txt keys, dispatched through a small open addressing table
+// instead of trying every key with sscanf on every line.
+enum
+{
+    CFG_KEY_FONT,
+    CFG_KEY_COLOR1,
+    CFG_KEY_COLOR2,
+    CFG_KEY_COLOR3,
+    CFG_KEY_COLOR4,
+    CFG_KEY_COLOR5,
+    CFG_KEY_COLOR6,
+    CFG_KEY_COLOR7,
+    CFG_KEY_RADIUS,
+    CFG_KEY_SHOWCLOCK,
+    CFG_KEY_CLOCK24H,
+    CFG_KEY_BATTERYPERC,
+    CFG_KEY_MENUANIM,
+    CFG_KEY_MENUTRANSITIONS,
+    CFG_KEY_RECENTS,
+    CFG_KEY_TOOLS,
+    CFG_KEY_GAMEART,
+    CFG_KEY_SCREENTIMEOUT,
+    CFG_KEY_SHOWFOLDERNAMESATROOT,
+    CFG_KEY_SUSPENDTIMEOUT,
+    CFG_KEY_POWEROFFPROTECTION,
+    CFG_KEY_SWITCHERSCALE,
+    CFG_KEY_HAPTICS,
+    CFG_KEY_ROMFOLDERBG,
+    CFG_KEY_SAVEFORMAT,
+    CFG_KEY_STATEFORMAT,
+    CFG_KEY_USEEXTRACTEDFILENAME,
+    CFG_KEY_MUTELEDS,
+    CFG_KEY_ARTWIDTH,
+    CFG_KEY_WIFI,
+    CFG_KEY_DEFAULTVIEW,
+    CFG_KEY_QUICKSWITCHERUI,
+    CFG_KEY_WIFIDIAGNOSTICS,
+    CFG_KEY_BLUETOOTH,
+    CFG_KEY_BTDIAGNOSTICS,
+    CFG_KEY_BTMAXRATE,
+    CFG_KEY_COUNT
+};
+
+static const char *cfg_keys[CFG_KEY_COUNT] = {
+    [CFG_KEY_FONT] = "font",
+    [CFG_KEY_COLOR1] = "color1",
+    [CFG_KEY_COLOR2] = "color2",
+    [CFG_KEY_COLOR3] = "color3",
+    [CFG_KEY_COLOR4] = "color4",
+    [CFG_KEY_COLOR5] = "color5",
+    [CFG_KEY_COLOR6] = "color6",
+    [CFG_KEY_COLOR7] = "color7",
+    [CFG_KEY_RADIUS] = "radius",
+    [CFG_KEY_SHOWCLOCK] = "showclock",
+    [CFG_KEY_CLOCK24H] = "clock24h",
+    [CFG_KEY_BATTERYPERC] = "batteryperc",
+    [CFG_KEY_MENUANIM] = "menuanim",
+    [CFG_KEY_MENUTRANSITIONS] = "menutransitions",
+    [CFG_KEY_RECENTS] = "recents",
+    [CFG_KEY_TOOLS] = "tools",
+    [CFG_KEY_GAMEART] = "gameart",
+    [CFG_KEY_SCREENTIMEOUT] = "screentimeout",
+    [CFG_KEY_SHOWFOLDERNAMESATROOT] = "showfoldernamesatroot",
+    [CFG_KEY_SUSPENDTIMEOUT] = "suspendTimeout",
+    [CFG_KEY_POWEROFFPROTECTION] = "powerOffProtection",
+    [CFG_KEY_SWITCHERSCALE] = "switcherscale",
+    [CFG_KEY_HAPTICS] = "haptics",
+    [CFG_KEY_ROMFOLDERBG] = "romfolderbg",
+    [CFG_KEY_SAVEFORMAT] = "saveFormat",
+    [CFG_KEY_STATEFORMAT] = "stateFormat",
+    [CFG_KEY_USEEXTRACTEDFILENAME] = "useExtractedFileName",
+    [CFG_KEY_MUTELEDS] = "muteLeds",
+    [CFG_KEY_ARTWIDTH] = "artWidth",
+    [CFG_KEY_WIFI] = "wifi",
+    [CFG_KEY_DEFAULTVIEW] = "defaultView",
+    [CFG_KEY_QUICKSWITCHERUI] = "quickSwitcherUi",
+    [CFG_KEY_WIFIDIAGNOSTICS] = "wifiDiagnostics",
+    [CFG_KEY_BLUETOOTH] = "bluetooth",
+    [CFG_KEY_BTDIAGNOSTICS] = "btDiagnostics",
+    [CFG_KEY_BTMAXRATE] = "btMaxRate",
+};
+
+#define CFG_KEY_SLOTS 128 // power of two, well above CFG_KEY_COUNT
+static int8_t cfg_key_slots[CFG_KEY_SLOTS];
+
+static uint32_t CFG_hashKey(const char *key, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void CFG_buildKeyTable(void)
+{
+    static bool built = false;
+    if (built)
+        return;
+    memset(cfg_key_slots, -1, sizeof(cfg_key_slots));
+    for (int id = 0; id < CFG_KEY_COUNT; id++)
+    {
+        uint32_t slot = CFG_hashKey(cfg_keys[id], strlen(cfg_keys[id])) & (CFG_KEY_SLOTS - 1);
+        while (cfg_key_slots[slot] != -1)
+            slot = (slot + 1) & (CFG_KEY_SLOTS - 1);
+        cfg_key_slots[slot] = id;
+    }
+    built = true;
+}
+
+static int CFG_lookupKey(const char *key, size_t len)
+{
+    uint32_t slot = CFG_hashKey(key, len) & (CFG_KEY_SLOTS - 1);
+    while (cfg_key_slots[slot] != -1)
+    {
+        const char *candidate = cfg_keys[(int)cfg_key_slots[slot]];
+        if (strncmp(candidate, key, len) == 0 && candidate[len] == '\0')
+            return cfg_key_slots[slot];
+        slot = (slot + 1) & (CFG_KEY_SLOTS - 1);
+    }
+    return -1;
+}
+
+static void CFG_applyKey(int id, const char *value)
+{
+    // colors are stored as 0xRRGGBB, everything else is a plain integer
+    if (id >= CFG_KEY_COLOR1 && id <= CFG_KEY_COLOR7)
+    {
+        CFG_setColor(id - CFG_KEY_COLOR1 + 1, (uint32_t)strtoul(value, NULL, 16));
+        return;
+    }
+
+    int temp_value = (int)strtol(value, NULL, 10);
+    switch (id)
+    {
+    case CFG_KEY_FONT: CFG_setFontId(temp_value); break;
+    case CFG_KEY_RADIUS: CFG_setThumbnailRadius(temp_value); break;
+    case CFG_KEY_SHOWCLOCK: CFG_setShowClock((bool)temp_value); break;
+    case CFG_KEY_CLOCK24H: CFG_setClock24H((bool)temp_value); break;
+    case CFG_KEY_BATTERYPERC: CFG_setShowBatteryPercent((bool)temp_value); break;
+    case CFG_KEY_MENUANIM: CFG_setMenuAnimations((bool)temp_value); break;
+    case CFG_KEY_MENUTRANSITIONS: CFG_setMenuTransitions((bool)temp_value); break;
+    case CFG_KEY_RECENTS: CFG_setShowRecents((bool)temp_value); break;
+    case CFG_KEY_TOOLS: CFG_setShowTools((bool)temp_value); break;
+    case CFG_KEY_GAMEART: CFG_setShowGameArt((bool)temp_value); break;
+    case CFG_KEY_SCREENTIMEOUT: CFG_setScreenTimeoutSecs(temp_value); break;
+    case CFG_KEY_SHOWFOLDERNAMESATROOT: CFG_setShowFolderNamesAtRoot((bool)temp_value); break;
+    case CFG_KEY_SUSPENDTIMEOUT: CFG_setSuspendTimeoutSecs(temp_value); break;
+    case CFG_KEY_POWEROFFPROTECTION: CFG_setPowerOffProtection((bool)temp_value); break;
+    case CFG_KEY_SWITCHERSCALE: CFG_setGameSwitcherScaling(temp_value); break;
+    case CFG_KEY_HAPTICS: CFG_setHaptics((bool)temp_value); break;
+    case CFG_KEY_ROMFOLDERBG: CFG_setRomsUseFolderBackground((bool)temp_value); break;
+    case CFG_KEY_SAVEFORMAT: CFG_setSaveFormat(temp_value); break;
+    case CFG_KEY_STATEFORMAT: CFG_setStateFormat(temp_value); break;
+    case CFG_KEY_USEEXTRACTEDFILENAME: CFG_setUseExtractedFileName((bool)temp_value); break;
+    case CFG_KEY_MUTELEDS: CFG_setMuteLEDs(temp_value); break;
+    case CFG_KEY_ARTWIDTH: CFG_setGameArtWidth((double)temp_value / 100.0); break;
+    case CFG_KEY_WIFI: CFG_setWifi((bool)temp_value); break;
+    case CFG_KEY_DEFAULTVIEW: CFG_setDefaultView(temp_value); break;
+    case CFG_KEY_QUICKSWITCHERUI: CFG_setShowQuickswitcherUI(temp_value); break;
+    case CFG_KEY_WIFIDIAGNOSTICS: CFG_setWifiDiagnostics(temp_value); break;
+    case CFG_KEY_BLUETOOTH: CFG_setBluetooth(temp_value); break;
+    case CFG_KEY_BTDIAGNOSTICS: CFG_setBluetoothDiagnostics(temp_value); break;
+    case CFG_KEY_BTMAXRATE: CFG_setBluetoothSamplingrateLimit(temp_value); break;
+    default: break;
+    }
+}
+
 void CFG_init(FontLoad_callback_t cb, ColorSet_callback_t ccb)
 {
+    uint64_t init_start = getMicroseconds();
     CFG_defaults(&settings);
     settings.onFontChange = cb;
     settings.onColorSet = ccb;
     bool fontLoaded = false;
+    int loaded = 0;
+
+    CFG_buildKeyTable();
+    // flush anything still pending if the process exits without CFG_quit
+    static bool registered = false;
+    if (!registered)
+    {
+        atexit(CFG_flush);
+        registered = true;
+    }
 
     char settingsPath[MAX_PATH];
     sprintf(settingsPath, "%s/minuisettings.txt", SHARED_USERDATA_PATH);
@@ -87,199 +293,27 @@ void CFG_init(FontLoad_callback_t cb, ColorSet_callback_t ccb)
     }
     else
     {
+        cfg_loading = true;
         char line[256];
         while (fgets(line, sizeof(line), file))
         {
-            int temp_value;
-            uint32_t temp_color;
-            if (sscanf(line, "font=%i", &temp_value) == 1)
-            {
-                CFG_setFontId(temp_value);
-                fontLoaded = true;
-                continue;
-            }
-            if (sscanf(line, "color1=%x", &temp_color) == 1)
-            {
-                char hexColor[7];
-                snprintf(hexColor, sizeof(hexColor), "%06x", temp_color);
-                CFG_setColor(1, HexToUint32_unmapped(hexColor));
-                continue;
-            }
-            if (sscanf(line, "color2=%x", &temp_color) == 1)
-            {
-                CFG_setColor(2, temp_color);
-                continue;
-            }
-            if (sscanf(line, "color3=%x", &temp_color) == 1)
-            {
-                CFG_setColor(3, temp_color);
+            char *eq = strchr(line, '=');
+            if (!eq)
                 continue;
-            }
-            if (sscanf(line, "color4=%x", &temp_color) == 1)
-            {
-                CFG_setColor(4, temp_color);
+            int id = CFG_lookupKey(line, eq - line);
+            if (id < 0)
                 continue;
-            }
-            if (sscanf(line, "color5=%x", &temp_color) == 1)
-            {
-                CFG_setColor(5, temp_color);
-                continue;
-            }
-            if (sscanf(line, "color6=%x", &temp_color) == 1)
-            {
-                CFG_setColor(6, temp_color);
-                continue;
-            }
-            if (sscanf(line, "color7=%x", &temp_color) == 1)
-            {
-                CFG_setColor(7, temp_color);
-                continue;
-            }
-            if (sscanf(line, "radius=%i", &temp_value) == 1)
-            {
-                CFG_setThumbnailRadius(temp_value);
-                continue;
-            }
-            if (sscanf(line, "showclock=%i", &temp_value) == 1)
-            {
-                CFG_setShowClock((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "clock24h=%i", &temp_value) == 1)
-            {
-                CFG_setClock24H((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "batteryperc=%i", &temp_value) == 1)
-            {
-                CFG_setShowBatteryPercent((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "menuanim=%i", &temp_value) == 1)
-            {
-                CFG_setMenuAnimations((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "menutransitions=%i", &temp_value) == 1)
-            {
-                CFG_setMenuTransitions((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "recents=%i", &temp_value) == 1)
-            {
-                CFG_setShowRecents((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "tools=%i", &temp_value) == 1)
-            {
-                CFG_setShowTools((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "gameart=%i", &temp_value) == 1)
-            {
-                CFG_setShowGameArt((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "screentimeout=%i", &temp_value) == 1)
-            {
-                CFG_setScreenTimeoutSecs(temp_value);
-                continue;
-            }
-            if (sscanf(line, "showfoldernamesatroot=%i", &temp_value) == 1)
-            {
-                CFG_setShowFolderNamesAtRoot((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "suspendTimeout=%i", &temp_value) == 1)
-            {
-                CFG_setSuspendTimeoutSecs(temp_value);
-                continue;
-            }
-            if (sscanf(line, "powerOffProtection=%i", &temp_value) == 1)
-            {
-                CFG_setPowerOffProtection((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "switcherscale=%i", &temp_value) == 1)
-            {
-                CFG_setGameSwitcherScaling(temp_value);
-                continue;
-            }
-            if (sscanf(line, "haptics=%i", &temp_value) == 1)
-            {
-                CFG_setHaptics((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "romfolderbg=%i", &temp_value) == 1)
-            {
-                CFG_setRomsUseFolderBackground((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "saveFormat=%i", &temp_value) == 1)
-            {
-                CFG_setSaveFormat(temp_value);
-                continue;
-            }
-            if (sscanf(line, "stateFormat=%i", &temp_value) == 1)
-            {
-                CFG_setStateFormat(temp_value);
-                continue;
-            }
-            if (sscanf(line, "useExtractedFileName=%i", &temp_value) == 1)
-            {
-                CFG_setUseExtractedFileName((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "muteLeds=%i", &temp_value) == 1)
-            {
-                CFG_setMuteLEDs(temp_value);
-                continue;
-            }
-            if (sscanf(line, "artWidth=%i", &temp_value) == 1)
-            {
-                CFG_setGameArtWidth((double)temp_value / 100.0);
-                continue;
-            }
-            if (sscanf(line, "wifi=%i", &temp_value) == 1)
-            {
-                CFG_setWifi((bool)temp_value);
-                continue;
-            }
-            if (sscanf(line, "defaultView=%i", &temp_value) == 1)
-            {
-                CFG_setDefaultView(temp_value);
-                continue;
-            }
-            if (sscanf(line, "quickSwitcherUi=%i", &temp_value) == 1)
-            {
-                CFG_setShowQuickswitcherUI(temp_value);
-                continue;
-            }
-            if (sscanf(line, "wifiDiagnostics=%i", &temp_value) == 1)
-            {
-                CFG_setWifiDiagnostics(temp_value);
-                continue;
-            }
-            if (sscanf(line, "bluetooth=%i", &temp_value) == 1)
-            {
-                CFG_setBluetooth(temp_value);
-                continue;
-            }
-            if (sscanf(line, "btDiagnostics=%i", &temp_value) == 1)
-            {
-                CFG_setBluetoothDiagnostics(temp_value);
-                continue;
-            }
-            if (sscanf(line, "btMaxRate=%i", &temp_value) == 1)
-            {
-                CFG_setBluetoothSamplingrateLimit(temp_value);
-                continue;
-            }
+            if (id == CFG_KEY_FONT)
+                fontLoaded = true;
+            CFG_applyKey(id, eq + 1);
+            loaded++;
         }
         fclose(file);
+        cfg_loading = false;
     }
 
     // load gfx related stuff until we drop the indirection
+    cfg_loading = true;
     CFG_setColor(1, CFG_getColor(1));
     CFG_setColor(2, CFG_getColor(2));
     CFG_setColor(3, CFG_getColor(3));
@@ -290,6 +324,9 @@ void CFG_init(FontLoad_callback_t cb, ColorSet_callback_t ccb)
     // avoid reloading the font if not neccessary
     if (!fontLoaded)
         CFG_setFontId(CFG_getFontId());
+    cfg_loading = false;
+
+    printf("[CFG] loaded %i settings in %lluus\n", loaded, (unsigned long long)(getMicroseconds() - init_start));
 }
 
 int CFG_getFontId(void)
@@ -309,6 +346,7 @@ void CFG_setFontId(int id)
 
     if(settings.onFontChange)
         settings.onFontChange(fontPath);
+    CFG_markDirty();
 }
 
 uint32_t CFG_getColor(int color_id)
@@ -372,6 +410,7 @@ void CFG_setColor(int color_id, uint32_t color)
 
     if(settings.onColorSet)
         settings.onColorSet();
+    CFG_markDirty();
 }
 
 bool CFG_getShowFolderNamesAtRoot(void)
@@ -382,7 +421,7 @@ bool CFG_getShowFolderNamesAtRoot(void)
 void CFG_setShowFolderNamesAtRoot(bool show)
 {
     settings.showFolderNamesAtRoot = show;
-	CFG_sync();
+	CFG_markDirty();
 }
 
 uint32_t CFG_getScreenTimeoutSecs(void)
@@ -393,7 +432,7 @@ uint32_t CFG_getScreenTimeoutSecs(void)
 void CFG_setScreenTimeoutSecs(uint32_t secs)
 {
     settings.screenTimeoutSecs = secs;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 uint32_t CFG_getSuspendTimeoutSecs(void)
@@ -404,7 +443,7 @@ uint32_t CFG_getSuspendTimeoutSecs(void)
 void CFG_setSuspendTimeoutSecs(uint32_t secs)
 {
     settings.suspendTimeoutSecs = secs;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getPowerOffProtection(void)
@@ -415,7 +454,7 @@ bool CFG_getPowerOffProtection(void)
 void CFG_setPowerOffProtection(bool enable)
 {
     settings.powerOffProtection = enable;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getShowClock(void)
@@ -426,7 +465,7 @@ bool CFG_getShowClock(void)
 void CFG_setShowClock(bool show)
 {
     settings.showClock = show;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getClock24H(void)
@@ -437,7 +476,7 @@ bool CFG_getClock24H(void)
 void CFG_setClock24H(bool is24)
 {
     settings.clock24h = is24;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getShowBatteryPercent(void)
@@ -448,7 +487,7 @@ bool CFG_getShowBatteryPercent(void)
 void CFG_setShowBatteryPercent(bool show)
 {
     settings.showBatteryPercent = show;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getMenuAnimations(void)
@@ -459,7 +498,7 @@ bool CFG_getMenuAnimations(void)
 void CFG_setMenuAnimations(bool show)
 {
     settings.showMenuAnimations = show;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getMenuTransitions(void)
@@ -470,7 +509,7 @@ bool CFG_getMenuTransitions(void)
 void CFG_setMenuTransitions(bool show)
 {
     settings.showMenuTransitions = show;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 int CFG_getThumbnailRadius(void)
@@ -481,7 +520,7 @@ int CFG_getThumbnailRadius(void)
 void CFG_setThumbnailRadius(int radius)
 {
     settings.thumbRadius = clamp(radius, 0, 24);
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getShowRecents(void)
@@ -492,7 +531,7 @@ bool CFG_getShowRecents(void)
 void CFG_setShowRecents(bool show)
 {
     settings.showRecents = show;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getShowTools(void)
@@ -503,7 +542,7 @@ bool CFG_getShowTools(void)
 void CFG_setShowTools(bool show)
 {
     settings.showTools = show;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getShowGameArt(void)
@@ -514,7 +553,7 @@ bool CFG_getShowGameArt(void)
 void CFG_setShowGameArt(bool show)
 {
     settings.showGameArt = show;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getRomsUseFolderBackground(void)
@@ -525,7 +564,7 @@ bool CFG_getRomsUseFolderBackground(void)
 void CFG_setRomsUseFolderBackground(bool folder)
 {
     settings.romsUseFolderBackground = folder;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 int CFG_getGameSwitcherScaling(void)
@@ -536,7 +575,7 @@ int CFG_getGameSwitcherScaling(void)
 void CFG_setGameSwitcherScaling(int enumValue)
 {
     settings.gameSwitcherScaling = clamp(enumValue, 0, GFX_SCALE_NUM_OPTIONS);
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getHaptics(void)
@@ -547,7 +586,7 @@ bool CFG_getHaptics(void)
 void CFG_setHaptics(bool enable)
 {
     settings.haptics = enable;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 int CFG_getSaveFormat(void)
@@ -558,7 +597,7 @@ int CFG_getSaveFormat(void)
 void CFG_setSaveFormat(int f)
 {
     settings.saveFormat = f;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 int CFG_getStateFormat(void)
@@ -569,7 +608,7 @@ int CFG_getStateFormat(void)
 void CFG_setStateFormat(int f)
 {
     settings.stateFormat = f;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getUseExtractedFileName(void)
@@ -580,7 +619,7 @@ bool CFG_getUseExtractedFileName(void)
 void CFG_setUseExtractedFileName(bool use)
 {
     settings.useExtractedFileName = use;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getMuteLEDs(void)
@@ -591,7 +630,7 @@ bool CFG_getMuteLEDs(void)
 void CFG_setMuteLEDs(bool on)
 {
     settings.muteLeds = on;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 double CFG_getGameArtWidth(void)
@@ -602,7 +641,7 @@ double CFG_getGameArtWidth(void)
 void CFG_setGameArtWidth(double zeroToOne)
 {
     settings.gameArtWidth = clampd(zeroToOne, 0.0, 1.0);
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getWifi(void)
@@ -613,7 +652,7 @@ bool CFG_getWifi(void)
 void CFG_setWifi(bool on)
 {
     settings.wifi = on;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 int CFG_getDefaultView(void)
@@ -624,7 +663,7 @@ int CFG_getDefaultView(void)
 void CFG_setDefaultView(int view)
 {
     settings.defaultView = view;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getShowQuickswitcherUI(void)
@@ -635,7 +674,7 @@ bool CFG_getShowQuickswitcherUI(void)
 void CFG_setShowQuickswitcherUI(bool on)
 {
     settings.showQuickSwitcherUi = on;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getWifiDiagnostics(void)
@@ -646,7 +685,7 @@ bool CFG_getWifiDiagnostics(void)
 void CFG_setWifiDiagnostics(bool on)
 {
     settings.wifiDiagnostics = on;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getBluetooth(void)
@@ -657,7 +696,7 @@ bool CFG_getBluetooth(void)
 void CFG_setBluetooth(bool on)
 {
     settings.bluetooth = on;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 bool CFG_getBluetoothDiagnostics(void)
@@ -668,7 +707,7 @@ bool CFG_getBluetoothDiagnostics(void)
 void CFG_setBluetoothDiagnostics(bool on)
 {
     settings.bluetoothDiagnostics = on;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 int CFG_getBluetoothSamplingrateLimit(void)
@@ -679,7 +718,7 @@ int CFG_getBluetoothSamplingrateLimit(void)
 void CFG_setBluetoothSamplingrateLimit(int value)
 {
     settings.bluetoothSamplerateLimit = value;
-    CFG_sync();
+    CFG_markDirty();
 }
 
 void CFG_get(const char *key, char *value)
@@ -851,7 +890,11 @@ void CFG_sync(void)
     }
 
     snprintf(settingsPath, sizeof(settingsPath), "%s/minuisettings.txt", shared_userdata);
-    FILE *file = fopen(settingsPath, "w");
+    // write next to the real file and rename over it so a power cut mid-write
+    // never leaves a truncated settings file behind
+    char tmpPath[MAX_PATH + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", settingsPath);
+    FILE *file = fopen(tmpPath, "w");
     if (file == NULL)
     {
         printf("[CFG] Unable to open settings file, cant write\n");
@@ -895,7 +938,18 @@ void CFG_sync(void)
     fprintf(file, "btDiagnostics=%i\n", settings.bluetoothDiagnostics);
     fprintf(file, "btMaxRate=%i\n", settings.bluetoothSamplerateLimit);
 
+    fflush(file);
+    fsync(fileno(file));
     fclose(file);
+    if (rename(tmpPath, settingsPath) != 0)
+    {
+        printf("[CFG] Unable to replace settings file\n");
+        unlink(tmpPath);
+        return;
+    }
+    cfg_dirty = false;
+    cfg_writes++;
+    printf("[CFG] settings written (%i writes this session)\n", cfg_writes);
 }
 
 void CFG_print(void)
@@ -947,7 +1001,13 @@ void CFG_print(void)
     printf("}\n");
 }
 
+void CFG_flush(void)
+{
+    if (cfg_dirty)
+        CFG_sync();
+}
+
 void CFG_quit(void)
 {
-    CFG_sync();
+    CFG_flush();
 }
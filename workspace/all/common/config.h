@@ -257,7 +257,13 @@ void CFG_setBluetoothDiagnostics(bool on);
 int CFG_getBluetoothSamplingrateLimit(void);
 void CFG_setBluetoothSamplingrateLimit(int value);
 
+// Writes the settings file now. Setters only mark the store dirty, the
+// write happens from CFG_poll() once changes settle, or on sleep/exit.
 void CFG_sync(void);
+// Call regularly (PWR_update does), flushes pending changes after a short quiet period.
+void CFG_poll(void);
+// Writes pending changes right away, if any (sleep, power off).
+void CFG_flush(void);
 void CFG_quit(void);
 
 #endif
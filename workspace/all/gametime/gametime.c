@@ -47,9 +47,22 @@ static void sigHandler(int sig)
 #define IMG_MAX_HEIGHT BIG_PILL_SIZE - IMG_MARGIN
 
 static SDL_Surface *screen;
-static SDL_Surface **romImages;
 
-static PlayActivities *play_activities;
+// rows are fetched a page at a time from the ranking libgametimedb
+// keeps, only the visible window and the page after it are held in
+// memory
+#define PAGE_SLOTS 3
+typedef struct Page {
+    int index; // -1 when the slot is free
+    PlayActivities *rows;
+    SDL_Surface **images; // NULL until the art worker delivers them
+    uint32_t used_at;
+} Page;
+static Page pages[PAGE_SLOTS];
+static uint32_t page_clock = 0;
+
+static int play_activity_count = 0;
+static int play_time_total = 0;
 
 static inline SDL_Color colorFromUint(uint32_t colour)
 {
@@ -179,23 +192,183 @@ SDL_Surface *loadRomImage(char *image_path)
     return dst;
 }
 
-void preloadRomImages()
+// box art is decoded off the main thread, a page at a time
+typedef struct ArtJob {
+    int page;
+    int count;
+    char **paths;
+    SDL_Surface **images;
+    struct ArtJob *next;
+} ArtJob;
+static ArtJob *art_todo = NULL;
+static ArtJob *art_done = NULL;
+static SDL_mutex *art_mutex;
+static SDL_cond *art_cond;
+static SDL_Thread *art_thread;
+static bool art_quit = false;
+
+static void freeArtJob(ArtJob *job, bool free_images)
 {
-    // load all rom images into SDL_Surfaces
-    romImages = malloc(sizeof(SDL_Surface *) * play_activities->count);
-    for (int i = 0; i < play_activities->count; i++) {
-        PlayActivity *entry = play_activities->play_activity[i];
-        ROM *rom = entry->rom;
-        romImages[i] = loadRomImage(rom->image_path);
+    for (int i = 0; i < job->count; i++) {
+        free(job->paths[i]);
+        if (free_images)
+            SDL_FreeSurface(job->images[i]);
+    }
+    free(job->paths);
+    if (free_images)
+        free(job->images);
+    free(job);
+}
+
+static int artWorker(void *arg)
+{
+    SDL_LockMutex(art_mutex);
+    while (!art_quit) {
+        if (!art_todo) {
+            SDL_CondWait(art_cond, art_mutex);
+            continue;
+        }
+        // newest request first, that's the page the user is heading to
+        ArtJob *job = art_todo;
+        art_todo = job->next;
+        SDL_UnlockMutex(art_mutex);
+
+        for (int i = 0; i < job->count; i++)
+            job->images[i] = job->paths[i] ? loadRomImage(job->paths[i]) : NULL;
+
+        SDL_LockMutex(art_mutex);
+        job->next = art_done;
+        art_done = job;
     }
+    SDL_UnlockMutex(art_mutex);
+    return 0;
 }
 
-void freeRomImages()
+static void requestArt(Page *page)
 {
-    for (int i = 0; i < play_activities->count; i++) {
-        SDL_FreeSurface(romImages[i]);
+    ArtJob *job = calloc(1, sizeof(ArtJob));
+    job->page = page->index;
+    job->count = page->rows->count;
+    job->paths = calloc(job->count, sizeof(char *));
+    job->images = calloc(job->count, sizeof(SDL_Surface *));
+    for (int i = 0; i < job->count; i++) {
+        char *image_path = page->rows->play_activity[i]->rom->image_path;
+        job->paths[i] = image_path ? strdup(image_path) : NULL;
     }
-    free(romImages);
+
+    SDL_LockMutex(art_mutex);
+    job->next = art_todo;
+    art_todo = job;
+    SDL_CondSignal(art_cond);
+    SDL_UnlockMutex(art_mutex);
+}
+
+// hands finished art to its page, returns true if anything changed
+static bool collectArt(void)
+{
+    SDL_LockMutex(art_mutex);
+    ArtJob *done = art_done;
+    art_done = NULL;
+    SDL_UnlockMutex(art_mutex);
+
+    bool changed = false;
+    while (done) {
+        ArtJob *job = done;
+        done = job->next;
+
+        Page *page = NULL;
+        for (int i = 0; i < PAGE_SLOTS; i++) {
+            if (pages[i].index == job->page && !pages[i].images)
+                page = &pages[i];
+        }
+        if (page) {
+            page->images = job->images;
+            changed = true;
+        }
+        freeArtJob(job, page == NULL); // page was evicted in the meantime
+    }
+    return changed;
+}
+
+static void freePage(Page *page)
+{
+    if (page->rows) {
+        if (page->images) {
+            for (int i = 0; i < page->rows->count; i++)
+                SDL_FreeSurface(page->images[i]);
+            free(page->images);
+        }
+        free_play_activities(page->rows);
+    }
+    page->index = -1;
+    page->rows = NULL;
+    page->images = NULL;
+}
+
+static Page *getPage(int index)
+{
+    Page *page = NULL;
+    for (int i = 0; i < PAGE_SLOTS; i++) {
+        if (pages[i].index == index) {
+            page = &pages[i];
+            break;
+        }
+        if (!page || pages[i].used_at < page->used_at)
+            page = &pages[i]; // least recently used so far
+    }
+
+    if (page->index != index) {
+        freePage(page);
+        page->index = index;
+        page->rows = play_activity_find_page(index * layout.items_per_page, layout.items_per_page);
+        requestArt(page);
+    }
+    page->used_at = ++page_clock;
+    return page;
+}
+
+static PlayActivity *getEntry(int index, SDL_Surface **image)
+{
+    Page *page = getPage(index / layout.items_per_page);
+    int row = index % layout.items_per_page;
+    if (row >= page->rows->count) {
+        *image = NULL;
+        return NULL;
+    }
+    *image = page->images ? page->images[row] : NULL;
+    return page->rows->play_activity[row];
+}
+
+static void initPages(void)
+{
+    for (int i = 0; i < PAGE_SLOTS; i++) {
+        pages[i].index = -1;
+        pages[i].used_at = 0;
+    }
+    art_mutex = SDL_CreateMutex();
+    art_cond = SDL_CreateCond();
+    art_thread = SDL_CreateThread(artWorker, "artWorker", NULL);
+}
+
+static void quitPages(void)
+{
+    SDL_LockMutex(art_mutex);
+    art_quit = true;
+    SDL_CondSignal(art_cond);
+    SDL_UnlockMutex(art_mutex);
+    SDL_WaitThread(art_thread, NULL);
+
+    while (art_todo) {
+        ArtJob *job = art_todo;
+        art_todo = job->next;
+        freeArtJob(job, true);
+    }
+    collectArt();
+    for (int i = 0; i < PAGE_SLOTS; i++)
+        freePage(&pages[i]);
+
+    SDL_DestroyCond(art_cond);
+    SDL_DestroyMutex(art_mutex);
 }
 
 void renderList(int count, int start, int end, int selected)
@@ -216,7 +389,10 @@ void renderList(int count, int start, int end, int selected)
     for (int index=start,row=0; index<end; index++,row++) {
         bool isSelected = selected_row == row;
 
-        PlayActivity *entry = play_activities->play_activity[index];
+        SDL_Surface *romImage;
+        PlayActivity *entry = getEntry(index, &romImage);
+        if (!entry)
+            break;
         ROM *rom = entry->rom;
 
         renderRoundedRectangle((SDL_Rect){
@@ -226,7 +402,6 @@ void renderList(int count, int start, int end, int selected)
             elemHeight
         }, isSelected ? RGB_WHITE : RGB_BLACK, SCALE1(24));
 
-        SDL_Surface *romImage = romImages[index];
         if (romImage) {
             SDL_Rect rectRomImage = {
                 layout.list_display_start_x + num_width + thumbMargin / 2 + (SCALE1(IMG_MAX_WIDTH) - romImage->w) / 2, 
@@ -326,7 +501,9 @@ void initLayout()
     layout.list_display_rect.h = layout.list_display_size_y;
 
     layout.items_per_page = layout.list_display_size_y / SCALE1(BIG_PILL_SIZE);
-    layout.num_pages = (int)ceil((double)play_activities->count / (double)layout.items_per_page);
+    if (layout.items_per_page < 1)
+        layout.items_per_page = 1;
+    layout.num_pages = (int)ceil((double)play_activity_count / (double)layout.items_per_page);
 }
 
 int main(int argc, char *argv[])
@@ -342,12 +519,13 @@ int main(int argc, char *argv[])
     signal(SIGINT, sigHandler);
     signal(SIGTERM, sigHandler);
 
-    play_activities = play_activity_find_all();
-    LOG_debug("found %d roms\n", play_activities->count);
+    uint64_t started_at = getMicroseconds();
+    play_activity_summary(&play_activity_count, &play_time_total);
+    LOG_debug("found %d roms\n", play_activity_count);
 
     initLayout();
-    preloadRomImages();
-    int count = play_activities->count;
+    initPages();
+    int count = play_activity_count;
     int selected = 0;
     int start = 0;
     int end = MIN(count, layout.items_per_page);
@@ -403,6 +581,9 @@ int main(int argc, char *argv[])
 
         PWR_update(&dirty, &show_setting, NULL, NULL);
 
+        if (collectArt())
+            dirty = 1;
+
         if (dirty) {
             GFX_clear(screen);
 
@@ -414,7 +595,6 @@ int main(int argc, char *argv[])
                     max_width = screen->w - SCALE1(PADDING * 2) - ow;
                 }
 
-                int play_time_total = play_activities->play_time_total;
                 char play_time_total_formatted[255];
                 serializeTime(play_time_total_formatted, play_time_total);
                 char display_name[256];
@@ -432,6 +612,9 @@ int main(int argc, char *argv[])
             }
 
             renderList(count, start, end, selected);
+            // warm up the page below the window so scrolling into it doesn't stall
+            if (end < count)
+                getPage(end / layout.items_per_page);
 
             if (show_setting)
                 GFX_blitHardwareHints(screen, show_setting);
@@ -441,6 +624,10 @@ int main(int argc, char *argv[])
             GFX_blitButtonGroup((char *[]){"B", "BACK", NULL}, 1, screen, 1);
 
             GFX_flip(screen);
+            if (started_at) {
+                LOG_info("first page took %lluus\n", (unsigned long long)(getMicroseconds() - started_at));
+                started_at = 0;
+            }
             dirty = 0;
         }
         else {
@@ -448,8 +635,7 @@ int main(int argc, char *argv[])
         }
     }
 
-    freeRomImages();
-    free_play_activities(play_activities);
+    quitPages();
 
     QuitSettings();
     PWR_quit();
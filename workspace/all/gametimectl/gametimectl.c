@@ -1,5 +1,6 @@
 // heavily modified from the Onion original: https://github.com/OnionUI/Onion/blob/main/src/playActivity/playActivity.c
 #include <stdio.h>
+#include <unistd.h>
 
 #include "defines.h"
 #include "api.h"
@@ -14,7 +15,68 @@ void printUsage()
            "       gametimectl start [rom_path] -> Launch the counter for this rom\n"
            "       gametimectl resume           -> Resume the last rom as a new play activity\n"
            "       gametimectl stop [rom_path]  -> Stop the counter for this rom\n"
-           "       gametimectl stop_all         -> Stop the counter for all roms\n");
+           "       gametimectl stop_all         -> Stop the counter for all roms\n"
+           "       gametimectl bench [roms] [pairs] -> Time start/stop pairs on a scratch db\n");
+}
+
+// seeds a scratch db with rom_count roms and three finished sessions
+// each, then times start/stop pairs on random roms against it and the
+// tracker's reads. the real game log is never opened, so this is safe
+// to run on device
+#define BENCH_DB_FILE "/tmp/gametime_bench.sqlite"
+static int bench(int rom_count, int pairs)
+{
+    unlink(BENCH_DB_FILE);
+    unlink(BENCH_DB_FILE "-wal");
+    unlink(BENCH_DB_FILE "-shm");
+    play_activity_db_use(BENCH_DB_FILE);
+    sqlite3 *db = play_activity_db_open();
+    if (!db)
+        return EXIT_FAILURE;
+
+    char sql[1024];
+    snprintf(sql, sizeof(sql),
+             "BEGIN;"
+             "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < %d) "
+             "INSERT INTO rom(type, name, file_path, image_path) SELECT '', 'Bench ' || i, 'Bench/Bench ' || i || '.zip', '' FROM n;"
+             "INSERT INTO play_activity(rom_id, play_time, created_at) "
+             "SELECT rom.id, abs(random() %% 3600), strftime('%%s', 'now') - abs(random() %% 31536000) "
+             "FROM rom, (SELECT 1 UNION ALL SELECT 2 UNION ALL SELECT 3);"
+             "COMMIT;",
+             rom_count);
+    uint64_t seeded_at = getMicroseconds();
+    if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        printf("%s\n", sqlite3_errmsg(db));
+        return EXIT_FAILURE;
+    }
+    printf("seeded %d roms in %llums\n", rom_count, (unsigned long long)(getMicroseconds() - seeded_at) / 1000);
+
+    srand(1); // same roms every run
+    uint64_t started_at = getMicroseconds();
+    for (int i = 0; i < pairs; i++) {
+        char rom_path[MAX_PATH];
+        snprintf(rom_path, sizeof(rom_path), ROMS_PATH "/Bench/Bench %d.zip", 1 + rand() % rom_count);
+        play_activity_start(rom_path);
+        play_activity_stop(rom_path);
+    }
+    uint64_t elapsed = getMicroseconds() - started_at;
+    printf("%d start/stop pairs: %lluus total, %lluus per pair\n", pairs,
+           (unsigned long long)elapsed, (unsigned long long)elapsed / (pairs > 0 ? pairs : 1));
+
+    // what the tracker does on open, then a page from the end of the list
+    int count = 0;
+    started_at = getMicroseconds();
+    play_activity_summary(&count, NULL);
+    printf("summary of %d roms: %lluus\n", count, (unsigned long long)(getMicroseconds() - started_at));
+    int offsets[] = {0, count > 8 ? count - 8 : 0};
+    for (int i = 0; i < 2; i++) {
+        started_at = getMicroseconds();
+        PlayActivities *page = play_activity_find_page(offsets[i], 8);
+        printf("page at %d: %lluus\n", offsets[i], (unsigned long long)(getMicroseconds() - started_at));
+        free_play_activities(page);
+    }
+
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[])
@@ -23,7 +85,17 @@ int main(int argc, char *argv[])
         printUsage();
         return EXIT_SUCCESS;
     }
+    if (strcmp(argv[1], "bench") == 0) {
+        int rom_count = argc > 2 ? atoi(argv[2]) : 10000;
+        int pairs = argc > 3 ? atoi(argv[3]) : 100;
+        if (rom_count <= 0 || pairs < 0) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        return bench(rom_count, pairs);
+    }
 
+    uint64_t started_at = getMicroseconds();
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "start") == 0) {
             if (i + 1 < argc) {
@@ -64,6 +136,7 @@ int main(int argc, char *argv[])
             return EXIT_FAILURE;
         }
     }
+    LOG_info("gametimectl %s took %lluus\n", argv[1], (unsigned long long)(getMicroseconds() - started_at));
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -12,6 +12,30 @@
 #define BATTERY_LOG_PATH SHARED_USERDATA_PATH
 #define BATTERY_LOG_FILE BATTERY_LOG_PATH "/battery_logs.sqlite"
 
+// bat_session keeps the running on-battery time since the last charge
+// per device, batmon adds to it on every flush so readers never have to
+// sum bat_activity again. Older logs get it backfilled once here.
+static void ensure_session_table(sqlite3* bat_log_db)
+{
+    sqlite3_stmt *stmt;
+    bool has_table = false;
+    if (sqlite3_prepare_v2(bat_log_db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'bat_session';", -1, &stmt, NULL) == SQLITE_OK) {
+        has_table = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+    if (has_table)
+        return;
+
+    sqlite3_exec(bat_log_db,
+                 "BEGIN IMMEDIATE;"
+                 "CREATE TABLE IF NOT EXISTS bat_session(device_serial TEXT PRIMARY KEY, duration INTEGER);"
+                 "INSERT OR IGNORE INTO bat_session(device_serial, duration)"
+                 " SELECT c.device_serial, COALESCE((SELECT SUM(a.duration) FROM bat_activity a WHERE a.device_serial = c.device_serial AND a.id > c.charged_id), 0)"
+                 " FROM (SELECT device_serial, MAX(id) AS charged_id FROM bat_activity WHERE is_charging = 1 GROUP BY device_serial) c;"
+                 "COMMIT;",
+                 NULL, NULL, NULL);
+}
+
 sqlite3* open_battery_log_db(void)
 {
     mkdir(BATTERY_LOG_PATH, 0755);
@@ -27,6 +51,11 @@ sqlite3* open_battery_log_db(void)
         return NULL;
     }
 
+    // batmon keeps this open for hours while the battery page reads it,
+    // WAL lets both happen and keeps each commit to one append
+    sqlite3_busy_timeout(bat_log_db, 1000);
+    sqlite3_exec(bat_log_db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+
     if (!db_exists) {
         sqlite3_exec(bat_log_db,
                      "DROP TABLE IF EXISTS bat_activity;"
@@ -40,6 +69,8 @@ sqlite3* open_battery_log_db(void)
                      NULL, NULL, NULL);
     }
 
+    ensure_session_table(bat_log_db);
+
     return bat_log_db;
 }
 
@@ -74,4 +105,49 @@ int get_best_session_time(sqlite3* bat_log_db, const char* device)
     }
     
     return best_time;
-}
\ No newline at end of file
+}
+int get_session_time(sqlite3* bat_log_db, const char* device)
+{
+    int session_time = 0;
+
+    if (bat_log_db != NULL) {
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(bat_log_db, "SELECT duration FROM bat_session WHERE device_serial = ?;", -1, &stmt, NULL) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, device, -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                session_time = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    return session_time;
+}
+
+void set_session_time(sqlite3* bat_log_db, const char* device, int session_time)
+{
+    if (bat_log_db == NULL)
+        return;
+
+    static sqlite3 *prepared_for = NULL;
+    static sqlite3_stmt *insert_stmt = NULL;
+    static sqlite3_stmt *update_stmt = NULL;
+    if (prepared_for != bat_log_db) {
+        sqlite3_finalize(insert_stmt);
+        sqlite3_finalize(update_stmt);
+        insert_stmt = update_stmt = NULL;
+        sqlite3_prepare_v2(bat_log_db, "INSERT OR IGNORE INTO bat_session(device_serial, duration) VALUES(?1, 0);", -1, &insert_stmt, NULL);
+        sqlite3_prepare_v2(bat_log_db, "UPDATE bat_session SET duration = ?2 WHERE device_serial = ?1;", -1, &update_stmt, NULL);
+        prepared_for = bat_log_db;
+    }
+    if (!insert_stmt || !update_stmt)
+        return;
+
+    sqlite3_bind_text(insert_stmt, 1, device, -1, SQLITE_STATIC);
+    sqlite3_step(insert_stmt);
+    sqlite3_reset(insert_stmt);
+
+    sqlite3_bind_text(update_stmt, 1, device, -1, SQLITE_STATIC);
+    sqlite3_bind_int(update_stmt, 2, session_time);
+    sqlite3_step(update_stmt);
+    sqlite3_reset(update_stmt);
+}
@@ -5,5 +5,8 @@
 sqlite3* open_battery_log_db(void);
 void close_battery_log_db(sqlite3* ctx);
 int get_best_session_time(sqlite3* ctx, const char* device);
+// seconds on battery since the last charge, kept current by batmon
+int get_session_time(sqlite3* ctx, const char* device);
+void set_session_time(sqlite3* ctx, const char* device, int session_time);
 
 #endif // __batmon_db_h__
\ No newline at end of file
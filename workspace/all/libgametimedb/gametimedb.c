@@ -15,21 +15,112 @@
 #define GAMETIME_LOG_PATH SHARED_USERDATA_PATH
 #define GAMETIME_LOG_FILE GAMETIME_LOG_PATH "/game_logs.sqlite"
 
+// one handle per process, opened on first use and kept until exit so
+// the schema check and statement compilation only happen once
+static sqlite3 *game_log_db = NULL;
+static char game_log_file[MAX_PATH] = GAMETIME_LOG_FILE;
+
+enum {
+    STMT_ROM_BY_PATH,
+    STMT_ROM_ORPHAN,
+    STMT_ROM_INSERT,
+    STMT_ROM_UPDATE,
+    STMT_ACTIVITY_START,
+    STMT_ACTIVITY_STOP,
+    STMT_ACTIVITY_OPEN,
+    STMT_PLAY_TIME,
+    STMT_COUNT
+};
+static const char *stmt_sql[STMT_COUNT] = {
+    [STMT_ROM_BY_PATH] = "SELECT id FROM rom WHERE file_path = ?1 LIMIT 1;",
+    [STMT_ROM_ORPHAN] = "SELECT id FROM rom WHERE (name = ?1 OR name = ?2) AND type = 'ORPHAN' LIMIT 1;",
+    [STMT_ROM_INSERT] = "INSERT INTO rom(type, name, file_path, image_path) VALUES(?1, ?2, ?3, ?4);",
+    [STMT_ROM_UPDATE] = "UPDATE rom SET type = ?1, name = ?2, file_path = ?3, image_path = ?4 WHERE id = ?5;",
+    [STMT_ACTIVITY_START] = "INSERT INTO play_activity(rom_id) VALUES(?1);",
+    [STMT_ACTIVITY_STOP] = "UPDATE play_activity SET play_time = (strftime('%s', 'now')) - created_at, updated_at = (strftime('%s', 'now')) WHERE rom_id = ?1 AND play_time IS NULL;",
+    [STMT_ACTIVITY_OPEN] = "SELECT 1 FROM play_activity WHERE rom_id = ?1 AND play_time IS NULL LIMIT 1;",
+    [STMT_PLAY_TIME] = "SELECT SUM(play_time) FROM play_activity WHERE rom_id = ?1;",
+};
+static sqlite3_stmt *stmt_cache[STMT_COUNT];
+
+static void play_activity_db_shutdown(void)
+{
+    for (int i = 0; i < STMT_COUNT; i++) {
+        sqlite3_finalize(stmt_cache[i]);
+        stmt_cache[i] = NULL;
+    }
+    sqlite3_close(game_log_db);
+    game_log_db = NULL;
+}
+
+// per rom totals for the tracker, kept current by triggers as sessions
+// are written so reading the ranking never aggregates play_activity.
+// sessions only ever get their play_time set after the insert, a delete
+// (negative play_time cleanup) is rare enough to recount that one rom
+static void __db_ensure_summary(sqlite3* game_log_db)
+{
+    sqlite3_stmt *stmt = NULL;
+    bool found = false;
+    const char *sql = "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'rom_play_summary';";
+    if (sqlite3_prepare_v2(game_log_db, sql, -1, &stmt, NULL) == SQLITE_OK)
+        found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    if (found)
+        return;
+
+    // older dbs get it built once from their existing sessions, IF NOT
+    // EXISTS covers another process having done that in the meantime
+    int rc = sqlite3_exec(game_log_db,
+        "BEGIN IMMEDIATE;"
+        "CREATE TABLE IF NOT EXISTS rom_play_summary(rom_id INTEGER PRIMARY KEY, play_count INTEGER, play_time_total INTEGER, first_played_at INTEGER, last_played_at INTEGER);"
+        "CREATE INDEX IF NOT EXISTS rom_play_summary_time_index ON rom_play_summary(play_time_total);"
+        "CREATE TRIGGER IF NOT EXISTS rom_play_summary_insert AFTER INSERT ON play_activity BEGIN"
+        "    INSERT OR IGNORE INTO rom_play_summary VALUES(NEW.rom_id, 0, 0, NEW.created_at, NEW.created_at);"
+        "    UPDATE rom_play_summary SET play_count = play_count + 1, play_time_total = play_time_total + IFNULL(NEW.play_time, 0),"
+        "        first_played_at = MIN(first_played_at, NEW.created_at), last_played_at = MAX(last_played_at, NEW.created_at)"
+        "        WHERE rom_id = NEW.rom_id;"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS rom_play_summary_update AFTER UPDATE OF play_time ON play_activity BEGIN"
+        "    UPDATE rom_play_summary SET play_time_total = play_time_total - IFNULL(OLD.play_time, 0) + IFNULL(NEW.play_time, 0)"
+        "        WHERE rom_id = NEW.rom_id;"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS rom_play_summary_delete AFTER DELETE ON play_activity BEGIN"
+        "    DELETE FROM rom_play_summary WHERE rom_id = OLD.rom_id;"
+        "    INSERT INTO rom_play_summary SELECT rom_id, COUNT(*), IFNULL(SUM(play_time), 0), MIN(created_at), MAX(created_at)"
+        "        FROM play_activity WHERE rom_id = OLD.rom_id GROUP BY rom_id;"
+        "END;"
+        "INSERT OR IGNORE INTO rom_play_summary SELECT rom_id, COUNT(*), IFNULL(SUM(play_time), 0), MIN(created_at), MAX(created_at)"
+        "    FROM play_activity GROUP BY rom_id;"
+        "COMMIT;",
+        NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        printf("%s\n", sqlite3_errmsg(game_log_db));
+        sqlite3_exec(game_log_db, "ROLLBACK;", NULL, NULL, NULL);
+    }
+}
+
 sqlite3* play_activity_db_open(void)
 {
+    if (game_log_db)
+        return game_log_db;
+
     mkdir(GAMETIME_LOG_PATH, 0777);
-    bool db_exists = exists(GAMETIME_LOG_FILE);
+    bool db_exists = exists(game_log_file);
     if (!db_exists)
-        touch(GAMETIME_LOG_FILE);
-
-    sqlite3 *game_log_db = NULL;
+        touch(game_log_file);
 
-    if (sqlite3_open(GAMETIME_LOG_FILE, &game_log_db) != SQLITE_OK) {
+    if (sqlite3_open(game_log_file, &game_log_db) != SQLITE_OK) {
         printf("%s\n", sqlite3_errmsg(game_log_db));
-        play_activity_db_close(game_log_db);
+        sqlite3_close(game_log_db);
+        game_log_db = NULL;
         return NULL;
     }
 
+    // WAL lets the tracker ui read while gametimectl writes and turns
+    // each commit into a single append instead of a rollback journal
+    sqlite3_busy_timeout(game_log_db, 1000);
+    sqlite3_exec(game_log_db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+
     if (!db_exists) {
         sqlite3_exec(game_log_db,
                      "DROP TABLE IF EXISTS rom;"
@@ -42,22 +133,77 @@ sqlite3* play_activity_db_open(void)
                      "CREATE INDEX play_activity_rom_id_index ON play_activity(rom_id);",
                      NULL, NULL, NULL);
     }
+    // every start/stop looks the rom up by path, older dbs lack this
+    sqlite3_exec(game_log_db, "CREATE INDEX IF NOT EXISTS rom_file_path_index ON rom(file_path);", NULL, NULL, NULL);
+    __db_ensure_summary(game_log_db);
 
+    atexit(play_activity_db_shutdown);
     return game_log_db;
 }
 
-void play_activity_db_close(sqlite3* game_log_db)
+int play_activity_db_use(const char *path)
 {
-    sqlite3_close(game_log_db);
-    game_log_db = NULL;
+    if (game_log_db)
+        return -1; // too late, the shared handle is already open
+    snprintf(game_log_file, sizeof(game_log_file), "%s", path);
+    return 0;
+}
+
+void play_activity_db_close(sqlite3* ctx)
+{
+    // the shared handle stays open until exit
+}
+
+// returns a reset statement from the cache, compiling it on first use
+static sqlite3_stmt *__db_stmt(sqlite3* game_log_db, int id)
+{
+    sqlite3_stmt *stmt = stmt_cache[id];
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return stmt;
+    }
+    if (sqlite3_prepare_v2(game_log_db, stmt_sql[id], -1, &stmt, NULL) != SQLITE_OK) {
+        printf("%s: %s\n", sqlite3_errmsg(game_log_db), stmt_sql[id]);
+        return NULL;
+    }
+    return stmt_cache[id] = stmt;
+}
+
+// runs a cached statement that yields at most one integer
+static int __db_step_int(sqlite3_stmt *stmt, int fallback)
+{
+    int value = fallback;
+    if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+        value = sqlite3_column_int(stmt, 0);
+    if (stmt)
+        sqlite3_reset(stmt);
+    return value;
+}
+
+static void __db_begin(sqlite3* game_log_db)
+{
+    // IMMEDIATE takes the write lock up front so a concurrent writer
+    // waits on busy_timeout instead of failing halfway through
+    sqlite3_exec(game_log_db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+}
+
+static void __db_commit(sqlite3* game_log_db)
+{
+    sqlite3_exec(game_log_db, "COMMIT;", NULL, NULL, NULL);
 }
 
 void free_play_activities(PlayActivities *pa_ptr)
 {
     for (int i = 0; i < pa_ptr->count; i++) {
+        ROM *rom = pa_ptr->play_activity[i]->rom;
+        free(rom->type);
+        free(rom->name);
+        free(rom->file_path);
+        free(rom->image_path);
         free(pa_ptr->play_activity[i]->first_played_at);
         free(pa_ptr->play_activity[i]->last_played_at);
-        free(pa_ptr->play_activity[i]->rom);
+        free(rom);
         free(pa_ptr->play_activity[i]);
     }
     free(pa_ptr->play_activity);
@@ -87,7 +233,9 @@ void get_rom_image_path(char *rom_file, char *out_image_path)
 int play_activity_db_transaction(sqlite3* game_log_db, int (*exec_transaction)(sqlite3*))
 {
     int retval;
+    __db_begin(game_log_db);
     retval = exec_transaction(game_log_db);
+    __db_commit(game_log_db);
     return retval;
 }
 
@@ -95,9 +243,7 @@ int play_activity_db_execute(char *sql)
 {
     //LOG_info("play_activity_db_execute(%s)\n", sql);
     sqlite3* game_log_db = play_activity_db_open();
-    int rc = sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
-    play_activity_db_close(game_log_db);
-    return rc;
+    return sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
 }
 
 sqlite3_stmt *play_activity_db_prepare(sqlite3* game_log_db, char *sql)
@@ -117,9 +263,7 @@ sqlite3_stmt *play_activity_db_prepare(sqlite3* game_log_db, char *sql)
 int play_activity_get_total_play_time(void)
 {
     int total_play_time = 0;
-    char *sql =
-        "SELECT SUM(play_time_total) FROM (SELECT SUM(play_time) AS play_time_total FROM play_activity GROUP BY rom_id) "
-        "WHERE play_time_total > 60;";
+    char *sql = "SELECT SUM(play_time_total) FROM rom_play_summary WHERE play_time_total > 60;";
     sqlite3_stmt *stmt;
 
     sqlite3* game_log_db = play_activity_db_open();
@@ -130,55 +274,68 @@ int play_activity_get_total_play_time(void)
     }
 
     sqlite3_finalize(stmt);
-    play_activity_db_close(game_log_db);
 
     return total_play_time;
 }
 
-PlayActivities *play_activity_find_all(void)
+// the ranking is rom_play_summary, which the session triggers keep
+// current, so this is only a count over it
+int play_activity_summary(int *count, int *play_time_total)
 {
-    PlayActivities *play_activities = NULL;
-    char *sql =
-        "SELECT * FROM ("
-        "    SELECT rom.id, rom.type, rom.name, rom.file_path, "
-        "           COUNT(play_activity.ROWID) AS play_count_total, "
-        "           SUM(play_activity.play_time) AS play_time_total, "
-        "           SUM(play_activity.play_time)/COUNT(play_activity.ROWID) AS play_time_average, "
-        "           datetime(MIN(play_activity.created_at), 'unixepoch') AS first_played_at, "
-        "           datetime(MAX(play_activity.created_at), 'unixepoch') AS last_played_at "
-        "    FROM rom LEFT JOIN play_activity ON rom.id = play_activity.rom_id "
-        "    GROUP BY rom.id) "
-        "WHERE play_time_total > 0 "
-        "ORDER BY play_time_total DESC;";
-    sqlite3_stmt *stmt;
-
     sqlite3* game_log_db = play_activity_db_open();
-
-    stmt = play_activity_db_prepare(game_log_db, sql);
-
-    int play_activity_count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        play_activity_count++;
+    if (!game_log_db)
+        return -1;
+
+    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db,
+        "SELECT COUNT(*), SUM(rom_play_summary.play_time_total) "
+        "FROM rom_play_summary JOIN rom ON rom.id = rom_play_summary.rom_id "
+        "WHERE rom_play_summary.play_time_total > 0;");
+    if (!stmt)
+        return -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (count)
+            *count = sqlite3_column_int(stmt, 0);
+        if (play_time_total)
+            *play_time_total = sqlite3_column_int(stmt, 1);
     }
-    sqlite3_reset(stmt);
+    sqlite3_finalize(stmt);
+    return 0;
+}
 
-    play_activities = (PlayActivities *)malloc(sizeof(PlayActivities));
-    play_activities->count = play_activity_count;
+PlayActivities *play_activity_find_page(int offset, int limit)
+{
+    PlayActivities *play_activities = (PlayActivities *)malloc(sizeof(PlayActivities));
+    play_activities->count = 0;
     play_activities->play_time_total = 0;
-    play_activities->play_activity = (PlayActivity **)malloc(sizeof(PlayActivity *) * play_activities->count);
-
-    for (int i = 0; i < play_activities->count; i++) {
-        if (sqlite3_step(stmt) != SQLITE_ROW)
-            break;
+    play_activities->play_activity = (PlayActivity **)malloc(sizeof(PlayActivity *) * (limit > 0 ? limit : 1));
 
-        PlayActivity *entry = play_activities->play_activity[i] = (PlayActivity *)malloc(sizeof(PlayActivity));
-        ROM *rom = play_activities->play_activity[i]->rom = (ROM *)malloc(sizeof(ROM));
+    sqlite3* game_log_db = play_activity_db_open();
+    if (!game_log_db)
+        return play_activities;
+
+    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db,
+        "SELECT rom.id, rom.type, rom.name, rom.file_path, "
+        "       rom_play_summary.play_count, rom_play_summary.play_time_total, "
+        "       rom_play_summary.play_time_total / rom_play_summary.play_count, "
+        "       datetime(rom_play_summary.first_played_at, 'unixepoch'), "
+        "       datetime(rom_play_summary.last_played_at, 'unixepoch') "
+        "FROM rom_play_summary JOIN rom ON rom.id = rom_play_summary.rom_id "
+        "WHERE rom_play_summary.play_time_total > 0 "
+        "ORDER BY rom_play_summary.play_time_total DESC, rom_play_summary.rom_id DESC LIMIT ?2 OFFSET ?1;");
+    if (!stmt)
+        return play_activities;
+    sqlite3_bind_int(stmt, 1, offset);
+    sqlite3_bind_int(stmt, 2, limit);
+
+    while (play_activities->count < limit && sqlite3_step(stmt) == SQLITE_ROW) {
+        PlayActivity *entry = play_activities->play_activity[play_activities->count++] = (PlayActivity *)malloc(sizeof(PlayActivity));
+        ROM *rom = entry->rom = (ROM *)calloc(1, sizeof(ROM));
         entry->first_played_at = NULL;
         entry->last_played_at = NULL;
 
         rom->id = sqlite3_column_int(stmt, 0);
-        rom->type = strdup((const char *)sqlite3_column_text(stmt, 1));
-        rom->name = strdup((const char *)sqlite3_column_text(stmt, 2));
+        rom->type = strdup(sqlite3_column_text(stmt, 1) ? (const char *)sqlite3_column_text(stmt, 1) : "");
+        rom->name = strdup(sqlite3_column_text(stmt, 2) ? (const char *)sqlite3_column_text(stmt, 2) : "");
         if (sqlite3_column_text(stmt, 3) != NULL) {
             rom->file_path = strdup((const char *)sqlite3_column_text(stmt, 3));
             rom->image_path = malloc(STR_MAX * sizeof(char));
@@ -189,10 +346,10 @@ PlayActivities *play_activity_find_all(void)
         entry->play_count = sqlite3_column_int(stmt, 4);
         entry->play_time_total = sqlite3_column_int(stmt, 5);
         entry->play_time_average = sqlite3_column_int(stmt, 6);
-        if (sqlite3_column_text(stmt, 8) != NULL) {
+        if (sqlite3_column_text(stmt, 7) != NULL) {
             entry->first_played_at = strdup((const char *)sqlite3_column_text(stmt, 7));
         }
-        if (sqlite3_column_text(stmt, 9) != NULL) {
+        if (sqlite3_column_text(stmt, 8) != NULL) {
             entry->last_played_at = strdup((const char *)sqlite3_column_text(stmt, 8));
         }
 
@@ -200,11 +357,17 @@ PlayActivities *play_activity_find_all(void)
     }
 
     sqlite3_finalize(stmt);
-    play_activity_db_close(game_log_db);
 
     return play_activities;
 }
 
+PlayActivities *play_activity_find_all(void)
+{
+    int count = 0;
+    play_activity_summary(&count, NULL);
+    return play_activity_find_page(0, count);
+}
+
 void __ensure_rel_path(char *rel_path, const char *rom_path)
 {
     if (!pathRelativeTo(rel_path, ROMS_PATH, rom_path)) {
@@ -219,23 +382,21 @@ void __ensure_rel_path(char *rel_path, const char *rom_path)
 
 int __db_insert_rom(sqlite3* game_log_db, const char *rom_type, const char *rom_name, const char *file_path, const char *image_path)
 {
-    int rom_id = ROM_NOT_FOUND;
-
     char rel_path[MAX_PATH];
     __ensure_rel_path(rel_path, file_path);
 
-    char *sql = sqlite3_mprintf("INSERT INTO rom(type, name, file_path, image_path) VALUES(%Q, %Q, %Q, %Q);",
-                                rom_type, rom_name, rel_path, image_path);
-    sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
-
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, "SELECT id FROM rom WHERE ROWID = last_insert_rowid()");
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        rom_id = sqlite3_column_int(stmt, 0);
-    }
-    sqlite3_finalize(stmt);
+    sqlite3_stmt *stmt = __db_stmt(game_log_db, STMT_ROM_INSERT);
+    if (!stmt)
+        return ROM_NOT_FOUND;
+    sqlite3_bind_text(stmt, 1, rom_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, rom_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, rel_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, image_path, -1, SQLITE_STATIC);
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
 
-    return rom_id;
+    // id is the INTEGER PRIMARY KEY so it's the rowid
+    return rc == SQLITE_DONE ? (int)sqlite3_last_insert_rowid(game_log_db) : ROM_NOT_FOUND;
 }
 
 void __db_update_rom(sqlite3* game_log_db, int rom_id, const char *rom_type, const char *rom_name, const char *file_path, const char *image_path)
@@ -243,52 +404,46 @@ void __db_update_rom(sqlite3* game_log_db, int rom_id, const char *rom_type, con
     char rel_path[MAX_PATH];
     __ensure_rel_path(rel_path, file_path);
 
-    char *sql = sqlite3_mprintf("UPDATE rom SET type = %Q, name = %Q, file_path = %Q, image_path = %Q WHERE id = %d;",
-                                rom_type, rom_name, rel_path, image_path, rom_id);
-    sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
+    sqlite3_stmt *stmt = __db_stmt(game_log_db, STMT_ROM_UPDATE);
+    if (!stmt)
+        return;
+    sqlite3_bind_text(stmt, 1, rom_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, rom_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, rel_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, image_path, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 5, rom_id);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
 }
 
 int __db_get_orphan_rom_id(sqlite3* game_log_db, const char *rom_path)
 {
-    int rom_id = ROM_NOT_FOUND;
     char *_file_name = strdup(rom_path);
     const char *file_name = baseName(_file_name);
     char *rom_name = removeExtension(file_name);
 
-    char *sql = sqlite3_mprintf("SELECT id FROM rom WHERE (name=%Q OR name=%Q) AND type='ORPHAN' LIMIT 1;", rom_name, file_name);
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-    sqlite3_free(sql);
-    free(rom_name);
-    free(_file_name);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        rom_id = sqlite3_column_int(stmt, 0);
+    sqlite3_stmt *stmt = __db_stmt(game_log_db, STMT_ROM_ORPHAN);
+    if (stmt) {
+        sqlite3_bind_text(stmt, 1, rom_name, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, file_name, -1, SQLITE_STATIC);
     }
+    int rom_id = __db_step_int(stmt, ROM_NOT_FOUND);
 
-    sqlite3_finalize(stmt);
+    free(rom_name);
+    free(_file_name);
 
     return rom_id;
 }
 
 int __db_get_rom_id_by_path(sqlite3* game_log_db, const char *rom_path)
 {
-    int rom_id = ROM_NOT_FOUND;
-
     char rel_path[MAX_PATH];
     __ensure_rel_path(rel_path, rom_path);
 
-    char *sql = sqlite3_mprintf("SELECT id FROM rom WHERE file_path=%Q LIMIT 1;", rel_path);
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-    sqlite3_free(sql);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        rom_id = sqlite3_column_int(stmt, 0);
-    }
-
-    sqlite3_finalize(stmt);
-
-    return rom_id;
+    sqlite3_stmt *stmt = __db_stmt(game_log_db, STMT_ROM_BY_PATH);
+    if (stmt)
+        sqlite3_bind_text(stmt, 1, rel_path, -1, SQLITE_STATIC);
+    return __db_step_int(stmt, ROM_NOT_FOUND);
 }
 
 int __db_rom_find_by_file_path(sqlite3* game_log_db, const char *rom_path, bool create_or_update)
@@ -323,8 +478,11 @@ int play_activity_transaction_rom_find_by_file_path(const char *rom_path, bool c
 {
     int retval;
     sqlite3* game_log_db = play_activity_db_open();
+    if (!game_log_db)
+        return ROM_NOT_FOUND;
+    __db_begin(game_log_db);
     retval = __db_rom_find_by_file_path(game_log_db, rom_path, create_or_update);
-    play_activity_db_close(game_log_db);
+    __db_commit(game_log_db);
     return retval;
 }
 
@@ -332,17 +490,17 @@ int play_activity_get_play_time(const char *rom_path)
 {
     int play_time = 0;
     sqlite3* game_log_db = play_activity_db_open();
+    if (!game_log_db)
+        return 0;
+    __db_begin(game_log_db);
     int rom_id = __db_rom_find_by_file_path(game_log_db, rom_path, false);
     if (rom_id != ROM_NOT_FOUND) {
-        char *sql = sqlite3_mprintf("SELECT SUM(play_time) FROM play_activity WHERE rom_id = %d;", rom_id);
-        sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-        sqlite3_free(sql);
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            play_time = sqlite3_column_int(stmt, 0);
-        }
-        sqlite3_finalize(stmt);
+        sqlite3_stmt *stmt = __db_stmt(game_log_db, STMT_PLAY_TIME);
+        if (stmt)
+            sqlite3_bind_int(stmt, 1, rom_id);
+        play_time = __db_step_int(stmt, 0);
     }
-    play_activity_db_close(game_log_db);
+    __db_commit(game_log_db);
     return play_time;
 }
 
@@ -383,67 +541,87 @@ int __db_get_active_closed_activity(sqlite3* game_log_db)
         return ROM_NOT_FOUND;
     }
 
-    char *sql = sqlite3_mprintf("SELECT * FROM play_activity WHERE rom_id = %d AND play_time IS NULL;", rom_id);
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    sqlite3_stmt *stmt = __db_stmt(game_log_db, STMT_ACTIVITY_OPEN);
+    if (stmt)
+        sqlite3_bind_int(stmt, 1, rom_id);
+    if (__db_step_int(stmt, 0)) {
         // Activity is not closed
         rom_id = ROM_NOT_FOUND;
     }
 
-    sqlite3_free(sql);
-    sqlite3_finalize(stmt);
-
     return rom_id;
 }
 
+// start, resume and stop each run their lookup and write in one
+// transaction so they cost a single commit
+static void __db_activity_exec(sqlite3* game_log_db, int id, int rom_id)
+{
+    sqlite3_stmt *stmt = __db_stmt(game_log_db, id);
+    if (!stmt)
+        return;
+    sqlite3_bind_int(stmt, 1, rom_id);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+}
+
 void play_activity_start(char *rom_file_path)
 {
     //LOG_info("\n:: play_activity_start(%s)\n", rom_file_path);
-    int rom_id = play_activity_transaction_rom_find_by_file_path(rom_file_path, true);
+    sqlite3* game_log_db = play_activity_db_open();
+    if (!game_log_db)
+        exit(1);
+    __db_begin(game_log_db);
+    int rom_id = __db_rom_find_by_file_path(game_log_db, rom_file_path, true);
+    if (rom_id != ROM_NOT_FOUND)
+        __db_activity_exec(game_log_db, STMT_ACTIVITY_START, rom_id);
+    __db_commit(game_log_db);
     if (rom_id == ROM_NOT_FOUND) {
         exit(1);
     }
-    char *sql = sqlite3_mprintf("INSERT INTO play_activity(rom_id) VALUES(%d);", rom_id);
-    play_activity_db_execute(sql);
-    sqlite3_free(sql);
 }
 
 void play_activity_resume(void)
 {
     //LOG_info("\n:: play_activity_resume()");
     sqlite3* game_log_db = play_activity_db_open();
-    int rom_id = play_activity_db_transaction(game_log_db, __db_get_active_closed_activity);
-    play_activity_db_close(game_log_db);
+    if (!game_log_db)
+        exit(1);
+    __db_begin(game_log_db);
+    int rom_id = __db_get_active_closed_activity(game_log_db);
+    if (rom_id != ROM_NOT_FOUND)
+        __db_activity_exec(game_log_db, STMT_ACTIVITY_START, rom_id);
+    __db_commit(game_log_db);
     if (rom_id == ROM_NOT_FOUND) {
         printf("Error: no active rom\n");
         exit(1);
     }
-    char *sql = sqlite3_mprintf("INSERT INTO play_activity(rom_id) VALUES(%d);", rom_id);
-    play_activity_db_execute(sql);
-    sqlite3_free(sql);
 }
 
 void play_activity_stop(char *rom_file_path)
 {
     //LOG_info("\n:: play_activity_stop(%s)\n", rom_file_path);
-    int rom_id = play_activity_transaction_rom_find_by_file_path(rom_file_path, false);
+    sqlite3* game_log_db = play_activity_db_open();
+    if (!game_log_db)
+        exit(1);
+    __db_begin(game_log_db);
+    int rom_id = __db_rom_find_by_file_path(game_log_db, rom_file_path, false);
+    if (rom_id != ROM_NOT_FOUND)
+        __db_activity_exec(game_log_db, STMT_ACTIVITY_STOP, rom_id);
+    __db_commit(game_log_db);
     if (rom_id == ROM_NOT_FOUND) {
         exit(1);
     }
-    char *sql = sqlite3_mprintf("UPDATE play_activity SET play_time = (strftime('%%s', 'now')) - created_at, updated_at = (strftime('%%s', 'now')) WHERE rom_id = %d AND play_time IS NULL;", rom_id);
-    play_activity_db_execute(sql);
-    sqlite3_free(sql);
 }
 
 void play_activity_stop_all(void)
 {
     //LOG_info("\n:: play_activity_stop_all()");
     play_activity_db_execute(
+        "BEGIN IMMEDIATE;"
         "UPDATE play_activity SET play_time = (strftime('%s', 'now')) - created_at, updated_at = (strftime('%s', 'now')) WHERE play_time IS NULL;"
-        "DELETE FROM play_activity WHERE play_time < 0;");
+        "DELETE FROM play_activity WHERE play_time < 0;"
+        "COMMIT;");
 }
-
 void play_activity_list_all(void)
 {
     //LOG_info("\n:: play_activity_list_all()");
@@ -28,11 +28,17 @@ struct PlayActivities {
 };
 
 sqlite3* play_activity_db_open(void);
+// points this process at another db file, only before the first open
+int play_activity_db_use(const char *path);
 void play_activity_db_close(sqlite3* ctx);
 void free_play_activities(PlayActivities *pa_ptr);
 
 // Main interface functions for read access
 PlayActivities *play_activity_find_all(void);
+// Paged read access: roms ranked by play time, the ranking is kept up to
+// date as sessions are written so neither call aggregates all activity
+int play_activity_summary(int *count, int *play_time_total);
+PlayActivities *play_activity_find_page(int offset, int limit);
 //int play_activity_get_play_time(const char *rom_path);
 
 // Main interface functions for write access
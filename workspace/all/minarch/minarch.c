@@ -13,6 +13,9 @@
 #include <zip.h> 
 #include <pthread.h>
 #include <glob.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 // libretro-common
 #include "libretro.h"
@@ -68,6 +71,11 @@ static int prevent_tearing = 1; // lenient
 static int use_core_fps = 0;
 static int sync_ref = 0;
 static int show_debug = 0;
+static int menu_shader_bg = 0;
+static int latency_probe = 0;
+static int late_poll = 0;
+static int threaded_video = 0;
+static int thread_pinning = 0; // cpu dedicated to emulation
 static int max_ff_speed = 3; // 4x
 static int ff_audio = 0;
 static int fast_forward = 0;
@@ -1125,8 +1133,26 @@ typedef struct OptionList {
 
 	OptionCategory *categories;
 	// OptionList_callback_t on_set;
+
+	// key -> option lookup, built lazily by OptionList_getOption()
+	int* index; // option index + 1, 0 is an empty slot
+	int index_mask;
 } OptionList;
 
+static uint32_t hashKey(const char* key, int len) {
+	uint32_t hash = 2166136261u;
+	for (int i=0; i<len; i++) {
+		hash ^= (uint8_t)key[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+static void OptionList_dropIndex(OptionList* list) {
+	if (list->index) free(list->index);
+	list->index = NULL;
+	list->index_mask = 0;
+}
+
 static char* onoff_labels[] = {
 	"Off",
 	"On",
@@ -1380,6 +1406,12 @@ enum {
 	FE_OPT_DEBUG,
 	FE_OPT_MAXFF,
 	FE_OPT_FF_AUDIO,
+	FE_OPT_STREAM_UPLOAD,
+	FE_OPT_MENU_SHADER_BG,
+	FE_OPT_LATENCY_PROBE,
+	FE_OPT_LATE_POLL,
+	FE_OPT_THREADED_VIDEO,
+	FE_OPT_THREAD_PINNING,
 	FE_OPT_COUNT,
 };
 
@@ -1544,6 +1576,13 @@ static char* button_labels[] = {
 	"MENU+R3",
 	NULL,
 };
+static char* thread_pinning_labels[] = {
+	"Off",
+	"CPU 1",
+	"CPU 2",
+	"CPU 3",
+	NULL,
+};
 static char* overclock_labels[] = {
 	"Powersave",
 	"Normal",
@@ -1742,6 +1781,66 @@ static struct Config {
 				.values = onoff_labels,
 				.labels = onoff_labels,
 			},
+			[FE_OPT_STREAM_UPLOAD] = {
+				.key	= "minarch_stream_upload",
+				.name	= "Streaming Upload",
+				.desc	= "Hand frames to the GPU through a ring\nof buffers instead of a blocking copy.\nCompare upload time in the Debug HUD.",
+				.default_value = 0,
+				.value = 0,
+				.count = 2,
+				.values = onoff_labels,
+				.labels = onoff_labels,
+			},
+			[FE_OPT_MENU_SHADER_BG] = {
+				.key	= "minarch_menu_shader_bg",
+				.name	= "Shaded Menu Background",
+				.desc	= "Capture the menu background and save\nstate previews with shaders and overlays.\nOff uses the last game frame, opens faster.",
+				.default_value = 0,
+				.value = 0,
+				.count = 2,
+				.values = onoff_labels,
+				.labels = onoff_labels,
+			},
+			[FE_OPT_LATENCY_PROBE] = {
+				.key	= "minarch_latency_probe",
+				.name	= "Latency Probe",
+				.desc	= "Measure button press to screen time.\nShown in the Debug HUD, histogram\nsaved as latency.txt per core.",
+				.default_value = 0,
+				.value = 0,
+				.count = 2,
+				.values = onoff_labels,
+				.labels = onoff_labels,
+			},
+			[FE_OPT_LATE_POLL] = {
+				.key	= "minarch_late_poll",
+				.name	= "Late Input Polling",
+				.desc	= "Read buttons when the core first asks\nfor them instead of at the start of the\nframe. Can shave off some input lag.",
+				.default_value = 0,
+				.value = 0,
+				.count = 2,
+				.values = onoff_labels,
+				.labels = onoff_labels,
+			},
+			[FE_OPT_THREADED_VIDEO] = {
+				.key	= "minarch_threaded_video",
+				.name	= "Threaded Video",
+				.desc	= "Draw the previous frame on a second\nthread while the core runs the next.\nHelps heavy cores, adds a frame of lag.",
+				.default_value = 0,
+				.value = 0,
+				.count = 2,
+				.values = onoff_labels,
+				.labels = onoff_labels,
+			},
+			[FE_OPT_THREAD_PINNING] = {
+				.key	= "minarch_thread_pinning",
+				.name	= "Thread Pinning",
+				.desc	= "Give emulation a CPU core of its own,\nrun audio in real time and keep other\nthreads off that core. Jitter in Debug HUD.",
+				.default_value = 0,
+				.value = 0,
+				.count = 4,
+				.values = thread_pinning_labels,
+				.labels = thread_pinning_labels,
+			},
 			[FE_OPT_COUNT] = {NULL}
 		}
 	},
@@ -1969,24 +2068,99 @@ static struct Config {
 		{NULL}
 	},
 };
-static int Config_getValue(char* cfg, const char* key, char* out_value, int* lock) { // gets value from string
-	char* tmp = cfg;
-	while ((tmp = strstr(tmp, key))) {
-		if (lock!=NULL && tmp>cfg && *(tmp-1)=='-') *lock = 1; // prefixed with a `-` means lock
-		tmp += strlen(key);
-		if (!strncmp(tmp, " = ", 3)) break; // matched
-	};
-	if (!tmp) return 0;
-	tmp += 3;
-	
-	strncpy(out_value, tmp, 256);
-	out_value[256 - 1] = '\0';
-	tmp = strchr(out_value, '\n');
-	if (!tmp) tmp = strchr(out_value, '\r');
-	if (tmp) *tmp = '\0';
+// A cfg blob parsed once into `key = value` entries indexed by key hash, so
+// reading every option is one lookup each instead of a strstr over the blob.
+typedef struct ConfigEntry {
+	const char* key;
+	const char* value;
+	int key_len;
+	int value_len;
+	int lock; // line was prefixed with a `-`
+} ConfigEntry;
+typedef struct ConfigIndex {
+	ConfigEntry* entries;
+	int* slots; // entry index + 1, 0 is an empty slot
+	int mask;
+	int count;
+} ConfigIndex;
 
-	// LOG_info("\t%s = %s (%s)\n", key, out_value, (lock && *lock) ? "hidden":"shown");
-	return 1;
+static void ConfigIndex_init(ConfigIndex* index, const char* cfg) {
+	memset(index, 0, sizeof(ConfigIndex));
+	if (!cfg) return;
+
+	// every break the splitter below honours can start a line, a crlf
+	// just counts twice
+	int lines = 1;
+	for (const char* tmp=cfg; *tmp; tmp++) if (*tmp=='\n' || *tmp=='\r') lines++;
+	int size = 16;
+	while (size < lines * 2) size <<= 1;
+
+	index->entries = calloc(lines, sizeof(ConfigEntry));
+	index->slots = calloc(size, sizeof(int));
+	index->mask = size - 1;
+	if (!index->entries || !index->slots) return;
+
+	const char* line = cfg;
+	while (*line) {
+		const char* end = line;
+		while (*end && *end!='\n' && *end!='\r') end++;
+
+		const char* key = line;
+		int lock = 0;
+		if (*key=='-') {
+			lock = 1;
+			key++;
+		}
+		const char* sep = strstr(key, " = ");
+		if (sep && sep<end && sep>key && index->count<lines) {
+			ConfigEntry* entry = &index->entries[index->count];
+			entry->key = key;
+			entry->key_len = sep - key;
+			entry->value = sep + 3;
+			entry->value_len = end - entry->value;
+			entry->lock = lock;
+
+			// first occurrence wins, like the old top-down search did
+			int slot = hashKey(entry->key, entry->key_len) & index->mask;
+			int duplicate = 0;
+			while (index->slots[slot]) {
+				ConfigEntry* other = &index->entries[index->slots[slot] - 1];
+				if (other->key_len==entry->key_len && !strncmp(other->key, entry->key, entry->key_len)) {
+					other->lock |= lock;
+					duplicate = 1;
+					break;
+				}
+				slot = (slot + 1) & index->mask;
+			}
+			if (!duplicate) index->slots[slot] = ++index->count;
+		}
+
+		line = end;
+		while (*line=='\n' || *line=='\r') line++;
+	}
+}
+static void ConfigIndex_free(ConfigIndex* index) {
+	free(index->entries);
+	free(index->slots);
+	memset(index, 0, sizeof(ConfigIndex));
+}
+static int Config_getValue(ConfigIndex* index, const char* key, char* out_value, int* lock) { // gets value from parsed config
+	if (!index->slots) return 0;
+	int len = strlen(key);
+	int slot = hashKey(key, len) & index->mask;
+	while (index->slots[slot]) {
+		ConfigEntry* entry = &index->entries[index->slots[slot] - 1];
+		if (entry->key_len==len && !strncmp(entry->key, key, len)) {
+			if (lock!=NULL && entry->lock) *lock = 1;
+			int value_len = entry->value_len < 255 ? entry->value_len : 255;
+			memcpy(out_value, entry->value, value_len);
+			out_value[value_len] = '\0';
+			// LOG_info("\t%s = %s (%s)\n", key, out_value, (lock && *lock) ? "hidden":"shown");
+			return 1;
+		}
+		slot = (slot + 1) & index->mask;
+	}
+	return 0;
 }
 
 
@@ -2100,6 +2274,32 @@ static void Config_syncFrontend(char* key, int value) {
 		ff_audio = value;
 		i = FE_OPT_FF_AUDIO;
 	}
+	else if (exactMatch(key,config.frontend.options[FE_OPT_STREAM_UPLOAD].key)) {
+		GFX_setStreamUpload(value);
+		i = FE_OPT_STREAM_UPLOAD;
+	}
+	else if (exactMatch(key,config.frontend.options[FE_OPT_MENU_SHADER_BG].key)) {
+		menu_shader_bg = value;
+		i = FE_OPT_MENU_SHADER_BG;
+	}
+	else if (exactMatch(key,config.frontend.options[FE_OPT_LATENCY_PROBE].key)) {
+		latency_probe = value;
+		PAD_setTimestamps(value);
+		i = FE_OPT_LATENCY_PROBE;
+	}
+	else if (exactMatch(key,config.frontend.options[FE_OPT_LATE_POLL].key)) {
+		late_poll = value;
+		i = FE_OPT_LATE_POLL;
+	}
+	else if (exactMatch(key,config.frontend.options[FE_OPT_THREADED_VIDEO].key)) {
+		threaded_video = value;
+		i = FE_OPT_THREADED_VIDEO;
+	}
+	else if (exactMatch(key,config.frontend.options[FE_OPT_THREAD_PINNING].key)) {
+		thread_pinning = value;
+		PWR_setThreadPinning(value);
+		i = FE_OPT_THREAD_PINNING;
+	}
 	if (i==-1) return;
 	Option* option = &config.frontend.options[i];
 	option->value = value;
@@ -2301,16 +2501,17 @@ static void Config_readOptionsString(char* cfg) {
 	if (!cfg) return;
 
 	LOG_info("Config_readOptions\n");
-	char key[256];
 	char value[256];
+	ConfigIndex index;
+	ConfigIndex_init(&index, cfg);
 	for (int i=0; config.frontend.options[i].key; i++) {
 		Option* option = &config.frontend.options[i];
-		if (!Config_getValue(cfg, option->key, value, &option->lock)) continue;
+		if (!Config_getValue(&index, option->key, value, &option->lock)) continue;
 		OptionList_setOptionValue(&config.frontend, option->key, value);
 		Config_syncFrontend(option->key, option->value);
 	}
 	
-	if (has_custom_controllers && Config_getValue(cfg,"minarch_gamepad_type",value,NULL)) {
+	if (has_custom_controllers && Config_getValue(&index,"minarch_gamepad_type",value,NULL)) {
 		gamepad_type = strtol(value, NULL, 0);
 		int device = strtol(gamepad_values[gamepad_type], NULL, 0);
 		core.set_controller_port_device(0, device);
@@ -2318,23 +2519,24 @@ static void Config_readOptionsString(char* cfg) {
 	for (int i=0; config.core.options[i].key; i++) {
 		Option* option = &config.core.options[i];
 		// LOG_info("%s\n",option->key);
-		if (!Config_getValue(cfg, option->key, value, &option->lock)) continue;
+		if (!Config_getValue(&index, option->key, value, &option->lock)) continue;
 		OptionList_setOptionValue(&config.core, option->key, value);
 	}
 	for (int i=0; config.shaders.options[i].key; i++) {
 		Option* option = &config.shaders.options[i];
-		if (!Config_getValue(cfg, option->key, value, &option->lock)) continue;
+		if (!Config_getValue(&index, option->key, value, &option->lock)) continue;
 		OptionList_setOptionValue(&config.shaders, option->key, value);
 	}
 	for (int y=0; y < config.shaders.options[SH_NROFSHADERS].value; y++) {
 		if(config.shaderpragmas[y].count > 0) {
 			for (int i=0; config.shaderpragmas[y].options[i].key; i++) {
 				Option* option = &config.shaderpragmas[y].options[i];
-				if (!Config_getValue(cfg, option->key, value, &option->lock)) continue;
+				if (!Config_getValue(&index, option->key, value, &option->lock)) continue;
 				OptionList_setOptionValue(&config.shaderpragmas[y], option->key, value);
 			}
 		}
 	}
+	ConfigIndex_free(&index);
 }
 static void Config_readControlsString(char* cfg) {
 	if (!cfg) return;
@@ -2344,12 +2546,14 @@ static void Config_readControlsString(char* cfg) {
 	char key[256];
 	char value[256];
 	char* tmp;
+	ConfigIndex index;
+	ConfigIndex_init(&index, cfg);
 	for (int i=0; config.controls[i].name; i++) {
 		ButtonMapping* mapping = &config.controls[i];
 		sprintf(key, "bind %s", mapping->name);
 		sprintf(value, "NONE");
 		
-		if (!Config_getValue(cfg, key, value, NULL)) continue;
+		if (!Config_getValue(&index, key, value, NULL)) continue;
 		if ((tmp = strrchr(value, ':'))) *tmp = '\0'; // this is a binding artifact in default.cfg, ignore
 		
 		int id = -1;
@@ -2376,7 +2580,7 @@ static void Config_readControlsString(char* cfg) {
 		sprintf(key, "bind %s", mapping->name);
 		sprintf(value, "NONE");
 
-		if (!Config_getValue(cfg, key, value, NULL)) continue;
+		if (!Config_getValue(&index, key, value, NULL)) continue;
 		
 		int id = -1;
 		for (int j=0; button_labels[j]; j++) {
@@ -2396,6 +2600,7 @@ static void Config_readControlsString(char* cfg) {
 		mapping->local = id;
 		mapping->mod = mod;
 	}
+	ConfigIndex_free(&index);
 }
 static void Config_load(void) {
 	LOG_info("Config_load\n");
@@ -2470,9 +2675,11 @@ static void Config_free(void) {
 	if (config.user_cfg) free(config.user_cfg);
 }
 static void Config_readOptions(void) {
+	uint64_t start = getMicroseconds();
 	Config_readOptionsString(config.system_cfg);
 	Config_readOptionsString(config.default_cfg);
 	Config_readOptionsString(config.user_cfg);
+	LOG_info("Config_readOptions took %lluus (%i core options)\n", (unsigned long long)(getMicroseconds() - start), config.core.count);
 }
 static void Config_readControls(void) {
 	Config_readControlsString(config.default_cfg);
@@ -2611,6 +2818,7 @@ void readShadersPreset(int i) {
 }
 void loadShaderSettings(int i) {
 	int menucount = 0;
+	OptionList_dropIndex(&config.shaderpragmas[i]);
 	config.shaderpragmas[i].options = calloc(32 + 1, sizeof(Option));
 	ShaderParam *params = PLAT_getShaderPragmas(i);
 	if(params == NULL) return;
@@ -2844,6 +3052,7 @@ static const char* getOptionNameFromKey(const char* key, const char* name) {
 // the following 3 functions always touch config.core, the rest can operate on arbitrary OptionLists
 static void OptionList_init(const struct retro_core_option_definition *defs) {
 	LOG_info("OptionList_init\n");
+	OptionList_dropIndex(&config.core);
 	int count;
 	for (count=0; defs[count].key; count++);
 	
@@ -2918,6 +3127,7 @@ static void OptionList_init(const struct retro_core_option_definition *defs) {
 
 static void OptionList_v2_init(const struct retro_core_options_v2 *opt_defs) {
 	LOG_info("OptionList_v2_init\n");
+	OptionList_dropIndex(&config.core);
 	struct retro_core_option_v2_category   *cats = opt_defs->categories;
 	struct retro_core_option_v2_definition *defs = opt_defs->definitions;
 
@@ -3000,6 +3210,7 @@ static void OptionList_v2_init(const struct retro_core_options_v2 *opt_defs) {
 
 static void OptionList_vars(const struct retro_variable *vars) {
 	LOG_info("OptionList_vars\n");
+	OptionList_dropIndex(&config.core);
 	int count;
 	for (count=0; vars[count].key; count++);
 	
@@ -3083,12 +3294,34 @@ static void OptionList_reset(void) {
 	if (config.core.enabled_options) free(config.core.enabled_options);
 	config.core.enabled_count = 0;
 	free(config.core.options);
+	OptionList_dropIndex(&config.core);
 }
 
-static Option* OptionList_getOption(OptionList* list, const char* key) {
+static void OptionList_buildIndex(OptionList* list) {
+	OptionList_dropIndex(list);
+	int size = 16;
+	while (size < list->count * 2) size <<= 1;
+	list->index = calloc(size, sizeof(int));
+	if (!list->index) return;
+	list->index_mask = size - 1;
 	for (int i=0; i<list->count; i++) {
-		Option* item = &list->options[i];
+		const char* key = list->options[i].key;
+		if (!key) continue;
+		int slot = hashKey(key, strlen(key)) & list->index_mask;
+		while (list->index[slot]) slot = (slot + 1) & list->index_mask;
+		list->index[slot] = i + 1;
+	}
+}
+static Option* OptionList_getOption(OptionList* list, const char* key) {
+	if (!list->count || !key) return NULL;
+	if (!list->index) OptionList_buildIndex(list);
+	if (!list->index) return NULL;
+
+	int slot = hashKey(key, strlen(key)) & list->index_mask;
+	while (list->index[slot]) {
+		Option* item = &list->options[list->index[slot] - 1];
 		if (!strcmp(item->key, key)) return item;
+		slot = (slot + 1) & list->index_mask;
 	}
 	return NULL;
 }
@@ -3140,6 +3373,8 @@ static void OptionList_setOptionVisibility(OptionList* list, const char* key, in
 void Menu_beforeSleep();
 void Menu_afterSleep();
 
+static void Pipeline_pause(void);
+
 static void Menu_screenshot(void);
 
 static void Menu_saveState(void);
@@ -3152,11 +3387,105 @@ static int setFastForward(int enable) {
 
 static uint32_t buttons = 0; // RETRO_DEVICE_ID_JOYPAD_* buttons
 static int ignore_menu = 0;
-static void input_poll_callback(void) {
-	PAD_poll();
 
-	int show_setting = 0;
-	PWR_update(NULL, &show_setting, Menu_beforeSleep, Menu_afterSleep);
+// input-to-photon probe: a press is stamped in PAD_poll, armed when it
+// first maps to a core button, marked seen once the core reads that
+// button and measured at the swap that shows the next frame it produces.
+// that swap may happen on the render thread, which only reports which
+// frame it showed and when, the sample itself is recorded here on the
+// main thread. a press the core never reads, or that is released before
+// it looks, expires instead
+#define LATENCY_BUCKET_US	2000
+#define LATENCY_BUCKETS		64 // last one catches everything above
+#define LATENCY_EXPIRE_FRAMES	30
+static struct {
+	uint64_t pressed_at;
+	uint32_t mask;
+	int seen;
+	uint32_t frame; // first one produced after seen
+	int frames; // since armed
+	uint32_t expired;
+	uint32_t hist[LATENCY_BUCKETS];
+	uint32_t count;
+	uint32_t max_us;
+} latency;
+static int latency_p50 = 0;
+static int latency_p99 = 0;
+static uint32_t Pipeline_lastShown(uint64_t* shown_at);
+
+static uint32_t Latency_percentile(uint32_t* hist, uint32_t count, int pct) {
+	uint32_t target = (count * pct + 99) / 100;
+	uint32_t total = 0;
+	for (int i=0; i<LATENCY_BUCKETS; i++) {
+		total += hist[i];
+		if (total>=target) return (i + 1) * LATENCY_BUCKET_US;
+	}
+	return LATENCY_BUCKETS * LATENCY_BUCKET_US;
+}
+static void Latency_cancel(void) {
+	latency.pressed_at = 0;
+	latency.seen = 0;
+	latency.frame = 0;
+	latency.frames = 0;
+}
+static void Latency_record(uint64_t shown_at) {
+	uint64_t dt = shown_at - latency.pressed_at;
+	int bucket = dt / LATENCY_BUCKET_US;
+	if (bucket>=LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+	latency.hist[bucket] += 1;
+	latency.count += 1;
+	if (dt>latency.max_us) latency.max_us = dt;
+	Latency_cancel();
+
+	latency_p50 = Latency_percentile(latency.hist, latency.count, 50) / 1000;
+	latency_p99 = Latency_percentile(latency.hist, latency.count, 99) / 1000;
+	if (latency.count%32==0) LOG_info("latency %s: n=%u p50<=%ims p99<=%ims max=%uus\n", core.tag, latency.count, latency_p50, latency_p99, latency.max_us);
+}
+static void Latency_save(void) {
+	// merged into the core's histogram so it builds up across sessions
+	if (!latency.count) return;
+
+	char path[MAX_PATH];
+	sprintf(path, "%s/latency.txt", core.config_dir);
+
+	uint32_t hist[LATENCY_BUCKETS];
+	memcpy(hist, latency.hist, sizeof(hist));
+	FILE* file = fopen(path, "r");
+	if (file) {
+		char line[64];
+		int bucket_ms;
+		unsigned count;
+		while (fgets(line, sizeof(line), file)) {
+			if (line[0]=='#' || sscanf(line, "%i %u", &bucket_ms, &count)!=2) continue;
+			int bucket = bucket_ms * 1000 / LATENCY_BUCKET_US - 1;
+			if (bucket>=0 && bucket<LATENCY_BUCKETS) hist[bucket] += count;
+		}
+		fclose(file);
+	}
+
+	uint32_t total = 0;
+	for (int i=0; i<LATENCY_BUCKETS; i++) total += hist[i];
+
+	file = fopen(path, "w");
+	if (!file) return;
+	fprintf(file, "# %s button to swap, buckets in ms (upper bound)\n", core.tag);
+	fprintf(file, "# n=%u p50<=%ims p99<=%ims\n", total, Latency_percentile(hist,total,50)/1000, Latency_percentile(hist,total,99)/1000);
+	for (int i=0; i<LATENCY_BUCKETS; i++) {
+		if (hist[i]) fprintf(file, "%i %u\n", (i + 1) * LATENCY_BUCKET_US / 1000, hist[i]);
+	}
+	fclose(file);
+	LOG_info("latency %s: session n=%u max=%uus expired=%u, saved to %s\n", core.tag, latency.count, latency.max_us, latency.expired, path);
+}
+
+// PAD_poll runs once per frame: from the core's poll callback, or in
+// late poll mode from its first input_state query so the input is as
+// fresh as possible. everything that isn't mapping buttons for the
+// core waits for Input_tick() after core.run()
+static int input_polled = 0;
+static void Input_poll(void) {
+	PAD_poll();
+	input_polled = 1;
+	uint32_t last_buttons = buttons;
 
 	// I _think_ this can stay as is...
 	if (PAD_justPressed(BTN_MENU)) {
@@ -3165,10 +3494,78 @@ static void input_poll_callback(void) {
 	if (PAD_isPressed(BTN_MENU) && (PAD_isPressed(BTN_PLUS) || PAD_isPressed(BTN_MINUS))) {
 		ignore_menu = 1;
 	}
+	
+	// TODO: figure out how to ignore button when MENU+button is handled first
+	// TODO: array size of LOCAL_ whatever that macro is
+	// TODO: then split it into two loops
+	// TODO: first check for MENU+button
+	// TODO: when found mark button the array
+	// TODO: then check for button
+	// TODO: only modify if absent from array
+	// TODO: the shortcuts loop in Input_tick() should also contribute to the array
+	
+	buttons = 0;
+	for (int i=0; config.controls[i].name; i++) {
+		ButtonMapping* mapping = &config.controls[i];
+		int btn = 1 << mapping->local;
+		if (btn==BTN_NONE) continue; // present buttons can still be unbound
+		if (gamepad_type==0) {
+			switch(btn) {
+				case BTN_DPAD_UP: 		btn = BTN_UP; break;
+				case BTN_DPAD_DOWN: 	btn = BTN_DOWN; break;
+				case BTN_DPAD_LEFT: 	btn = BTN_LEFT; break;
+				case BTN_DPAD_RIGHT: 	btn = BTN_RIGHT; break;
+			}
+		}
+		if (PAD_isPressed(btn) && (!mapping->mod || PAD_isPressed(BTN_MENU))) {
+			buttons |= 1 << mapping->retro;
+			if (mapping->mod) ignore_menu = 1;
+		}
+		//  && !PWR_ignoreSettingInput(btn, show_setting)
+	}
+	
+	// if (buttons) LOG_info("buttons: %i\n", buttons);
+
+	if (latency_probe && pad.pressed_at && !latency.pressed_at) {
+		uint32_t mask = buttons & ~last_buttons;
+		if (mask) {
+			latency.pressed_at = pad.pressed_at;
+			latency.mask = mask;
+			latency.frames = 0;
+		}
+	}
+}
+
+#define HOUSEKEEPING_INTERVAL 100 // ms
+static void Input_tick(void) {
+	if (!input_polled) Input_poll(); // core didn't ask for input this frame
+	input_polled = 0;
+
+	if (latency.frame) {
+		uint64_t shown_at;
+		uint32_t shown = Pipeline_lastShown(&shown_at);
+		if ((int32_t)(shown - latency.frame)>=0) Latency_record(shown_at);
+	}
+	else if (latency.pressed_at && !latency.seen && ++latency.frames>LATENCY_EXPIRE_FRAMES) {
+		latency.expired += 1;
+		Latency_cancel();
+	}
+
+	// power/charge/autosleep/led rules only need to react to button edges
+	// right away, the timers in there are fine with a coarse tick
+	static uint32_t housekept_at = 0;
+	uint32_t now = SDL_GetTicks();
+	if (pad.just_pressed || pad.just_released || pad.just_repeated || now - housekept_at >= HOUSEKEEPING_INTERVAL) {
+		housekept_at = now;
+		int show_setting = 0;
+		PWR_update(NULL, &show_setting, Menu_beforeSleep, Menu_afterSleep);
+	}
+
 	if (PAD_isPressed(BTN_MENU) && PAD_isPressed(BTN_SELECT)) {
 		ignore_menu = 1;
 		newScreenshot = 1;
 		quit = 1;
+		Pipeline_pause();
 		Menu_saveState();
 		putFile(GAME_SWITCHER_PERSIST_PATH, game.path + strlen(SDCARD_PATH));
 		GFX_clear(screen);
@@ -3228,6 +3625,7 @@ static void input_poll_callback(void) {
 				}
 			}
 			else if (PAD_justPressed(btn)) {
+				Pipeline_pause(); // these may capture the screen or change the renderer
 				switch (i) {
 					case SHORTCUT_SAVE_STATE: 
 						newScreenshot = 1;
@@ -3271,40 +3669,18 @@ static void input_poll_callback(void) {
 	if (!ignore_menu && PAD_justReleased(BTN_MENU)) {
 		show_menu = 1;
 	}
-	
-	// TODO: figure out how to ignore button when MENU+button is handled first
-	// TODO: array size of LOCAL_ whatever that macro is
-	// TODO: then split it into two loops
-	// TODO: first check for MENU+button
-	// TODO: when found mark button the array
-	// TODO: then check for button
-	// TODO: only modify if absent from array
-	// TODO: the shortcuts loop above should also contribute to the array
-	
-	buttons = 0;
-	for (int i=0; config.controls[i].name; i++) {
-		ButtonMapping* mapping = &config.controls[i];
-		int btn = 1 << mapping->local;
-		if (btn==BTN_NONE) continue; // present buttons can still be unbound
-		if (gamepad_type==0) {
-			switch(btn) {
-				case BTN_DPAD_UP: 		btn = BTN_UP; break;
-				case BTN_DPAD_DOWN: 	btn = BTN_DOWN; break;
-				case BTN_DPAD_LEFT: 	btn = BTN_LEFT; break;
-				case BTN_DPAD_RIGHT: 	btn = BTN_RIGHT; break;
-			}
-		}
-		if (PAD_isPressed(btn) && (!mapping->mod || PAD_isPressed(BTN_MENU))) {
-			buttons |= 1 << mapping->retro;
-			if (mapping->mod) ignore_menu = 1;
-		}
-		//  && !PWR_ignoreSettingInput(btn, show_setting)
-	}
-	
-	// if (buttons) LOG_info("buttons: %i\n", buttons);
+}
+
+static void input_poll_callback(void) {
+	if (!late_poll && !input_polled) Input_poll();
 }
 static int16_t input_state_callback(unsigned port, unsigned device, unsigned index, unsigned id) {
+	if (!input_polled) Input_poll();
 	if (port==0 && device==RETRO_DEVICE_JOYPAD && index==0) {
+		if (latency.pressed_at && !latency.seen) {
+			uint32_t read = id==RETRO_DEVICE_ID_JOYPAD_MASK ? buttons : buttons & (1 << id);
+			if (read & latency.mask) latency.seen = 1;
+		}
 		if (id == RETRO_DEVICE_ID_JOYPAD_MASK) return buttons;
 		return (buttons >> id) & 1;
 	}
@@ -4451,6 +4827,8 @@ static void selectScaler(int src_w, int src_h, int src_p) {
 	// }
 }
 static int firstframe = 1;
+static uint32_t flips = 0; // only touched by the thread that draws
+static uint64_t flipped_at = 0;
 static void screen_flip(SDL_Surface* screen) {
 	
 	if (use_core_fps) {
@@ -4460,142 +4838,11 @@ static void screen_flip(SDL_Surface* screen) {
 		GFX_GL_Swap();
 		// GFX_flip(screen);
 	}
+	flips += 1;
+	flipped_at = getMicroseconds();
 }
 
 
-// couple of animation functions for pixel data keeping them all cause wanna use them later
-void applyFadeIn(uint32_t **data, size_t pitch, unsigned width, unsigned height, int *frame_counter, int max_frames) {
-    size_t pixels_per_row = pitch / sizeof(uint32_t);
-    static uint32_t temp_buffer[1920 * 1080];
-
-    if (*frame_counter >= max_frames) {
-        return;
-    }
-
-    float progress = (float)(*frame_counter) / (float)max_frames;
-    float eased = progress * progress * (3 - 2 * progress);
-
-    float fade_alpha = eased;
-
-    for (unsigned y = 0; y < height; ++y) {
-        for (unsigned x = 0; x < width; ++x) {
-            size_t idx = y * pixels_per_row + x;
-
-            uint32_t color = (*data)[idx];
-
-            uint8_t a = (color >> 24) & 0xFF;
-            uint8_t b = (color >> 16) & 0xFF;
-            uint8_t g = (color >> 8) & 0xFF;
-            uint8_t r = (color >> 0) & 0xFF;
-
-            r = (uint8_t)(r * fade_alpha);
-            g = (uint8_t)(g * fade_alpha);
-            b = (uint8_t)(b * fade_alpha);
-            a = (uint8_t)(a * fade_alpha);
-
-            temp_buffer[idx] = (a << 24) | (b << 16) | (g << 8) | r;
-        }
-    }
-
-    (*frame_counter)++;
-    *data = temp_buffer;
-}
-
-void applyZoomFadeIn(uint32_t **data, size_t pitch, unsigned width, unsigned height, int *frame_counter, int max_frames) {
-    size_t pixels_per_row = pitch / sizeof(uint32_t);
-    static uint32_t temp_buffer[1920 * 1080];
-
-    if (*frame_counter >= max_frames)
-        return;
-
-    float progress = (float)(*frame_counter) / (float)max_frames;
-    float eased = progress * progress * (3.0f - 2.0f * progress);
-
-    float start_zoom = 6.0f;
-    float end_zoom = 1.0f;
-    float zoom = start_zoom - eased * (start_zoom - end_zoom);
-
-    float fade_alpha = eased;
-
-    int center_x = width / 2;
-    int center_y = height / 2;
-
-    for (unsigned y = 0; y < height; ++y) {
-        for (unsigned x = 0; x < width; ++x) {
-            float src_x = center_x + (x - center_x) / zoom;
-            float src_y = center_y + (y - center_y) / zoom;
-
-            int ix = (int)src_x;
-            int iy = (int)src_y;
-
-            size_t dst_idx = y * pixels_per_row + x;
-            uint32_t color = 0xFF000000; 
-
-            if (ix >= 0 && ix < (int)width && iy >= 0 && iy < (int)height) {
-                size_t src_idx = iy * pixels_per_row + ix;
-                color = (*data)[src_idx];
-            }
-
-            uint8_t a = (color >> 24) & 0xFF;
-            uint8_t b = (color >> 16) & 0xFF;
-            uint8_t g = (color >> 8) & 0xFF;
-            uint8_t r = (color >> 0) & 0xFF;
-
-            r = (uint8_t)(r * fade_alpha);
-            g = (uint8_t)(g * fade_alpha);
-            b = (uint8_t)(b * fade_alpha);
-            a = (uint8_t)(a * fade_alpha);
-
-            temp_buffer[dst_idx] = (a << 24) | (b << 16) | (g << 8) | r;
-        }
-    }
-
-    (*frame_counter)++;
-    *data = temp_buffer;
-}
-
-
-// Looney Tunes opening effect :D
-void applyCircleReveal(uint32_t **data, size_t pitch, unsigned width, unsigned height, int *frame_counter, int max_frames) {
-    static uint32_t temp_buffer[1920 * 1080];
-
-    if (*frame_counter >= max_frames)
-        return;
-
-    uint32_t *src = *data;
-    size_t pixels_per_row = pitch / sizeof(uint32_t);
-
-    float progress = (float)(*frame_counter) / (float)max_frames;
-    float eased = progress * progress * (3.0f - 2.0f * progress);
-
-    float max_radius = sqrtf((float)(width * width + height * height)) * 0.5f;
-    float radius = eased * max_radius;
-
-    int cx = (int)(width / 2);
-    int cy = (int)(height / 2);
-
-    for (unsigned y = 0; y < height; ++y) {
-        for (unsigned x = 0; x < width; ++x) {
-            size_t idx = y * pixels_per_row + x;
-
-            float dx = (float)x - (float)cx;
-            float dy = (float)y - (float)cy;
-            float dist = sqrtf(dx * dx + dy * dy);
-
-            if (dist <= radius) {
-                temp_buffer[idx] = src[idx];
-            } else {
-                uint32_t color = src[idx];
-                uint8_t a = (color >> 24) & 0xFF; 
-                temp_buffer[idx] = (a << 24);  
-            }
-        }
-    }
-
-    (*frame_counter)++;
-    *data = temp_buffer;
-}
-
 static void video_refresh_callback_main(const void *data, unsigned width, unsigned height, size_t pitch) {
 	// return;
 	
@@ -4660,6 +4907,18 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 		sprintf(debug_text, "%ix%i", renderer.dst_w,renderer.dst_h);
 		blitBitmapText(debug_text,-x,-y,(uint32_t*)data,pitch / 4, width,height);
 
+		sprintf(debug_text, "%s %ius", config.frontend.options[FE_OPT_STREAM_UPLOAD].value ? "pbo" : "tex", currentuploadus);
+		blitBitmapText(debug_text,-x,y + 14,(uint32_t*)data,pitch / 4, width,height);
+
+		// frame pacing from GFX_flip's pacer: deviation p50/p99/max and missed deadlines
+		sprintf(debug_text, "pace %i/%i/%ius %i %s", currentjitterp50, currentjitterp99, currentjittermax, currentmissedframes, thread_pinning_labels[thread_pinning]);
+		blitBitmapText(debug_text,-x,y + 28,(uint32_t*)data,pitch / 4, width,height);
+
+		if (latency_probe) {
+			sprintf(debug_text, "lat %i/%ims", latency_p50, latency_p99);
+			blitBitmapText(debug_text,-x,y + 42,(uint32_t*)data,pitch / 4, width,height);
+		}
+
 		//want this to overwrite bottom right in case screen is too small this info more important tbh
 		PLAT_getCPUTemp();
 		sprintf(debug_text, "%.01f/%.01f/%.0f%%/%ihz/%ic", currentfps, currentreqfps,currentcpuse,currentcpuspeed,currentcputemp);
@@ -4667,15 +4926,20 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 
 		sprintf(debug_text, "%i/%ix%i/%ix%i/%ix%i", currentshaderpass, currentshadersrcw,currentshadersrch,currentshadertexw,currentshadertexh,currentshaderdstw,currentshaderdsth);
 		blitBitmapText(debug_text,x,-y - 14,(uint32_t*)data,pitch / 4, width,height);
+
+		sprintf(debug_text, "texpool %i/%i/%i", currenttexcreated, currenttexuploads, currenttexreused);
+		blitBitmapText(debug_text,x,-y - 28,(uint32_t*)data,pitch / 4, width,height);
 	
 		double buffer_fill = (double) (currentbuffersize - currentbufferfree) / (double) currentbuffersize;
 		drawGauge(x, y + 30, buffer_fill, width / 2, 8, (uint32_t*)data, pitch / 4);
 	}
 	
+	// startup fade, drawn by the gpu over the finished frame
 	static int frame_counter = 0;
-	const int max_frames = 8; 
-	if(frame_counter<9) {
-		applyFadeIn((uint32_t **) &data, pitch, width, height, &frame_counter, max_frames);
+	const int max_frames = 8;
+	if (frame_counter<=max_frames) {
+		GFX_GL_setTransition(TRANSITION_FADE, (float)frame_counter / max_frames);
+		frame_counter += 1;
 	}
 
 	// LOG_info("video_refresh_callback: %ix%i@%i %ix%i@%i\n",width,height,pitch,screen->w,screen->h,screen->pitch);
@@ -4691,11 +4955,13 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 
 
 const void* lastframe = NULL;
+static unsigned lastframe_w = 0;
+static unsigned lastframe_h = 0;
 
 static Uint32* rgbaData = NULL;
 static size_t rgbaDataSize = 0;
 
-static void video_refresh_callback(const void* data, unsigned width, unsigned height, size_t pitch) {
+static void video_refresh_callback_convert(const void* data, unsigned width, unsigned height, size_t pitch) {
 
 	// I need to check quit here because sometimes quit is true but callback is still called by the core after and it still runs one more frame and it looks ugly :D
 	if(!quit) {
@@ -4754,10 +5020,256 @@ static void video_refresh_callback(const void* data, unsigned width, unsigned he
 
 		pitch = width * sizeof(Uint32);
 		lastframe = data;
+		lastframe_w = width;
+		lastframe_h = height;
 		
 		video_refresh_callback_main(data,width,height,pitch);
 	}
 }
+
+///////////////////////////////
+
+// threaded video: the core's frame is copied into a triple buffer and
+// converted, scaled and swapped on a render thread while the core runs
+// the next one. the render thread only holds the GL context between
+// Pipeline_resume() and Pipeline_pause(), anything on the main thread
+// that draws, captures or changes the renderer has to pause it first
+
+typedef struct PipelineSlot {
+	void* data;
+	size_t size; // allocated
+	unsigned width;
+	unsigned height;
+	size_t pitch;
+	int dupe;
+	uint32_t seq;
+} PipelineSlot;
+
+static struct {
+	SDL_Thread* thread;
+	SDL_mutex* lock;
+	SDL_cond* cond;
+	PipelineSlot slots[3];
+	int write; // filled by the core
+	int ready; // newest complete frame
+	int present; // being drawn
+	int queued; // ready hasn't been taken yet
+	int running; // only touched by the main thread
+	int current; // render thread holds the GL context
+	int quit;
+	uint32_t produced; // frames numbered by the main thread
+	uint32_t shown; // newest one swapped
+	uint64_t shown_at;
+	int capture; // an async readback is in flight, polled by the render thread
+	unsigned char* captured; // its pixels, waiting for the main thread
+	int captured_w;
+	int captured_h;
+	uint32_t frames;
+	uint32_t replaced;
+	uint32_t dropped;
+} pipeline = {
+	.write = 0,
+	.ready = 1,
+	.present = 2,
+};
+
+static int Pipeline_thread(void* arg) {
+	PWR_registerThread(THREAD_PROFILE_RENDER);
+	int current = 0;
+	SDL_LockMutex(pipeline.lock);
+	while (1) {
+		while (!pipeline.quit && !(pipeline.running && pipeline.queued)) {
+			if (current && !pipeline.running) {
+				GFX_GL_setCurrent(0);
+				current = 0;
+				pipeline.current = 0;
+				SDL_CondBroadcast(pipeline.cond);
+			}
+			SDL_CondWait(pipeline.cond, pipeline.lock);
+		}
+		if (pipeline.quit) break;
+
+		int present = pipeline.present;
+		pipeline.present = pipeline.ready;
+		pipeline.ready = present;
+		pipeline.queued = 0;
+		pipeline.frames += 1;
+		pipeline.current = 1;
+		int capture = pipeline.capture;
+		SDL_CondBroadcast(pipeline.cond); // the core can queue the next one
+		SDL_UnlockMutex(pipeline.lock);
+
+		if (!current) {
+			GFX_GL_setCurrent(1);
+			current = 1;
+		}
+		PipelineSlot* slot = &pipeline.slots[pipeline.present];
+		uint32_t flipped = flips;
+		video_refresh_callback_convert(slot->dupe ? NULL : slot->data, slot->width, slot->height, slot->pitch);
+
+		// the capture fence can only be checked with the context, so it's
+		// polled here instead of making the main thread take it every frame
+		int cw, ch;
+		unsigned char* captured = capture ? GFX_GL_screenCaptureCollect(&cw, &ch, 0) : NULL;
+
+		SDL_LockMutex(pipeline.lock);
+		if (flips!=flipped) {
+			pipeline.shown = slot->seq;
+			pipeline.shown_at = flipped_at;
+		}
+		if (captured) {
+			pipeline.capture = 0;
+			pipeline.captured = captured;
+			pipeline.captured_w = cw;
+			pipeline.captured_h = ch;
+		}
+	}
+	if (current) GFX_GL_setCurrent(0);
+	pipeline.current = 0;
+	SDL_CondBroadcast(pipeline.cond);
+	SDL_UnlockMutex(pipeline.lock);
+	PWR_unregisterThread();
+	return 0;
+}
+
+static void Pipeline_submit(const void* data, unsigned width, unsigned height, size_t pitch) {
+	if (quit) return;
+
+	PipelineSlot* slot = &pipeline.slots[pipeline.write];
+	slot->dupe = !data;
+	if (data) {
+		size_t size = (size_t)height * pitch;
+		if (slot->size<size) {
+			free(slot->data);
+			slot->data = malloc(size);
+			slot->size = slot->data ? size : 0;
+			if (!slot->data) return;
+		}
+		memcpy(slot->data, data, size);
+	}
+	slot->width = width;
+	slot->height = height;
+	slot->pitch = pitch;
+	slot->seq = pipeline.produced;
+
+	SDL_LockMutex(pipeline.lock);
+	// the core may only get one frame ahead of the swap so pacing and
+	// audio rate control behave as before, fast forward just replaces
+	// the frame that's still waiting
+	while (pipeline.queued && !fast_forward && pipeline.running) {
+		SDL_CondWait(pipeline.cond, pipeline.lock);
+	}
+	if (pipeline.queued) pipeline.replaced += 1;
+	int ready = pipeline.ready;
+	pipeline.ready = pipeline.write;
+	pipeline.write = ready;
+	pipeline.queued = 1;
+	SDL_CondBroadcast(pipeline.cond);
+	SDL_UnlockMutex(pipeline.lock);
+}
+
+static void Pipeline_pause(void) {
+	if (!pipeline.running) return;
+
+	SDL_LockMutex(pipeline.lock);
+	pipeline.running = 0;
+	SDL_CondBroadcast(pipeline.cond);
+	while (pipeline.current) SDL_CondWait(pipeline.cond, pipeline.lock);
+	// a frame still waiting would only be drawn on resume, a stale flash
+	// of whatever was on screen before the menu opened
+	if (pipeline.queued) {
+		pipeline.queued = 0;
+		pipeline.dropped += 1;
+	}
+	SDL_UnlockMutex(pipeline.lock);
+
+	GFX_GL_setCurrent(1);
+}
+
+static void Pipeline_resume(void) {
+	if (pipeline.running || !threaded_video) return;
+
+	if (!pipeline.thread) {
+		pipeline.lock = SDL_CreateMutex();
+		pipeline.cond = SDL_CreateCond();
+		pipeline.thread = SDL_CreateThread(Pipeline_thread, "VideoPipeline", NULL);
+		if (!pipeline.thread) {
+			LOG_info("Pipeline_resume: failed to create render thread (%s)\n", SDL_GetError());
+			threaded_video = 0;
+			return;
+		}
+		LOG_info("threaded video on\n");
+	}
+
+	GFX_GL_setCurrent(0);
+	SDL_LockMutex(pipeline.lock);
+	pipeline.running = 1;
+	SDL_CondBroadcast(pipeline.cond);
+	SDL_UnlockMutex(pipeline.lock);
+}
+
+static void Pipeline_quit(void) {
+	if (!pipeline.thread) return;
+
+	Pipeline_pause();
+	SDL_LockMutex(pipeline.lock);
+	pipeline.quit = 1;
+	SDL_CondBroadcast(pipeline.cond);
+	SDL_UnlockMutex(pipeline.lock);
+	SDL_WaitThread(pipeline.thread, NULL);
+	pipeline.thread = NULL;
+
+	LOG_info("threaded video: %u frames drawn, %u replaced while waiting, %u dropped on pause\n", pipeline.frames, pipeline.replaced, pipeline.dropped);
+
+	for (int i=0; i<3; i++) {
+		free(pipeline.slots[i].data);
+		pipeline.slots[i].data = NULL;
+		pipeline.slots[i].size = 0;
+	}
+	SDL_DestroyCond(pipeline.cond);
+	SDL_DestroyMutex(pipeline.lock);
+	pipeline.lock = NULL;
+}
+
+static void Pipeline_setCapture(int capture) {
+	if (pipeline.lock) SDL_LockMutex(pipeline.lock);
+	pipeline.capture = capture;
+	if (pipeline.lock) SDL_UnlockMutex(pipeline.lock);
+}
+static unsigned char* Pipeline_takeCapture(int* w, int* h) {
+	if (pipeline.lock) SDL_LockMutex(pipeline.lock);
+	unsigned char* pixels = pipeline.captured;
+	*w = pipeline.captured_w;
+	*h = pipeline.captured_h;
+	pipeline.captured = NULL;
+	if (pipeline.lock) SDL_UnlockMutex(pipeline.lock);
+	return pixels;
+}
+
+static uint32_t Pipeline_lastShown(uint64_t* shown_at) {
+	if (pipeline.lock) SDL_LockMutex(pipeline.lock);
+	uint32_t shown = pipeline.shown;
+	*shown_at = pipeline.shown_at;
+	if (pipeline.lock) SDL_UnlockMutex(pipeline.lock);
+	return shown;
+}
+
+static void video_refresh_callback(const void* data, unsigned width, unsigned height, size_t pitch) {
+	pipeline.produced += 1;
+	if (latency.seen && !latency.frame) latency.frame = pipeline.produced;
+
+	if (pipeline.running) Pipeline_submit(data, width, height, pitch);
+	else {
+		uint32_t flipped = flips;
+		video_refresh_callback_convert(data, width, height, pitch);
+		if (flips!=flipped) {
+			if (pipeline.lock) SDL_LockMutex(pipeline.lock);
+			pipeline.shown = pipeline.produced;
+			pipeline.shown_at = flipped_at;
+			if (pipeline.lock) SDL_UnlockMutex(pipeline.lock);
+		}
+	}
+}
 ///////////////////////////////
 
 static void audio_sample_callback(int16_t left, int16_t right) {
@@ -5051,6 +5563,8 @@ void Menu_quit(void) {
 	SDL_FreeSurface(menu.overlay);
 }
 void Menu_beforeSleep() {
+	Pipeline_pause();
+	Latency_cancel();
 	SRAM_write();
 	RTC_write();
 	State_autosave();
@@ -6453,14 +6967,36 @@ typedef struct {
     char* path;
 	int w;
 	int h;
+	int thumbnail;
 } SaveImageArgs;
 
+// Save state previews are drawn fullscreen by nextui's resume screen, so they
+// keep the full resolution and stay png despite the .bmp name: a raw bmp is
+// several times the size on the sd card and nothing shows it decodes faster.
+static void saveThumbnail(SDL_Surface* src, const char* path) {
+	SDL_RWops* rw = SDL_RWFromFile(path, "wb");
+	if (!rw || IMG_SavePNG_RW(src, rw, 1) != 0) {
+		SDL_Log("Failed to save thumbnail: %s", SDL_GetError());
+	}
+}
+
 int save_screenshot_thread(void* data) {
+	PWR_registerThread(THREAD_PROFILE_BACKGROUND);
 
     SaveImageArgs* args = (SaveImageArgs*)data;
 	SDL_Surface* rawSurface = SDL_CreateRGBSurfaceWithFormatFrom(
 		args->pixels, args->w, args->h, 32, args->w * 4, SDL_PIXELFORMAT_ABGR8888
 	);
+	if (args->thumbnail) {
+		saveThumbnail(rawSurface, args->path);
+		SDL_FreeSurface(rawSurface);
+		LOG_info("saved thumbnail\n");
+		free(args->path);
+		free(args->pixels);
+		free(args);
+		PWR_unregisterThread();
+		return 0;
+	}
 	SDL_Surface* converted = SDL_ConvertSurfaceFormat(rawSurface, SDL_PIXELFORMAT_RGBA8888, 0);
 	SDL_FreeSurface(rawSurface);
 
@@ -6477,9 +7013,64 @@ int save_screenshot_thread(void* data) {
     free(args->path);
     free(args->pixels);
     free(args);
+	PWR_unregisterThread();
     return 0;
 }
 SDL_Thread* screenshotsavethread;
+
+static void saveCapturedPixels(unsigned char* pixels, int w, int h, const char* path, int thumbnail) {
+	if (!pixels) return;
+	SaveImageArgs* args = malloc(sizeof(SaveImageArgs));
+	args->pixels = (char*)pixels;
+	args->w = w;
+	args->h = h;
+	args->path = SDL_strdup(path);
+	args->thumbnail = thumbnail;
+	SDL_WaitThread(screenshotsavethread, NULL);
+	screenshotsavethread = SDL_CreateThread(save_screenshot_thread, "SaveScreenshotThread", args);
+}
+
+// Captures requested from in-game shortcuts are read back asynchronously and
+// handed to the save thread once the gpu is done, see collectScreenCapture().
+static char* pending_capture_path = NULL;
+static int pending_capture_thumbnail = 0;
+
+static void collectScreenCapture(int wait) {
+	if (!pending_capture_path) return;
+
+	int cw, ch;
+	unsigned char* pixels = Pipeline_takeCapture(&cw, &ch);
+	if (!pixels) {
+		// while threaded video runs the render thread polls the fence,
+		// the context only comes back here when we have to wait for it
+		if (pipeline.running && !wait) return;
+		Pipeline_pause();
+		pixels = Pipeline_takeCapture(&cw, &ch); // it may have just got there
+		if (!pixels) pixels = GFX_GL_screenCaptureCollect(&cw, &ch, wait);
+		if (!pixels && !wait) return; // not ready yet
+	}
+	Pipeline_setCapture(0);
+
+	saveCapturedPixels(pixels, cw, ch, pending_capture_path, pending_capture_thumbnail);
+	free(pending_capture_path);
+	pending_capture_path = NULL;
+}
+
+static void requestScreenCapture(const char* path, int thumbnail) {
+	collectScreenCapture(1);
+
+	if (GFX_GL_screenCaptureAsync()) {
+		pending_capture_path = SDL_strdup(path);
+		pending_capture_thumbnail = thumbnail;
+		Pipeline_setCapture(1);
+		return;
+	}
+
+	int cw, ch;
+	unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
+	saveCapturedPixels(pixels, cw, ch, path, thumbnail);
+}
+
 static void Menu_screenshot(void) {
 	LOG_info("Menu_screenshot\n");
 
@@ -6497,15 +7088,7 @@ static void Menu_screenshot(void) {
 
 	char png_path[256];
 	sprintf(png_path, SDCARD_PATH "/Screenshots/%s.%s.png", rom_name, buffer);
-	int cw, ch;
-	unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
-	SaveImageArgs* args = malloc(sizeof(SaveImageArgs));
-	args->pixels = pixels;
-	args->w = cw;
-	args->h = ch;
-	args->path = SDL_strdup(png_path);
-	SDL_WaitThread(screenshotsavethread, NULL);
-	screenshotsavethread = SDL_CreateThread(save_screenshot_thread, "SaveScreenshotThread", args);
+	requestScreenCapture(png_path, 0);
 }
 static void Menu_saveState(void) {
 	// LOG_info("Menu_saveState\n");
@@ -6518,19 +7101,10 @@ static void Menu_saveState(void) {
 	
 	// if already in menu use menu.bitmap instead for saving screenshots otherwise create new one on the fly
 	if (newScreenshot) {
-		int cw, ch;
-		unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
-		SaveImageArgs* args = malloc(sizeof(SaveImageArgs));
-		args->pixels = pixels;
-		args->w = cw;
-		args->h = ch;
-		args->path = SDL_strdup(menu.bmp_path); 
-		SDL_WaitThread(screenshotsavethread, NULL);
-		screenshotsavethread = SDL_CreateThread(save_screenshot_thread, "SaveScreenshotThread", args);
+		requestScreenCapture(menu.bmp_path, 1);
 		newScreenshot = 0;
 	} else {
-		SDL_RWops* rw = SDL_RWFromFile(menu.bmp_path, "wb");
-		IMG_SavePNG_RW(menu.bitmap, rw,1);
+		saveThumbnail(menu.bitmap, menu.bmp_path);
 		LOG_info("saved screenshot\n");
 	}
 	
@@ -6562,20 +7136,72 @@ static void Menu_loadState(void) {
 	}
 }
 
-static void Menu_loop(void) {
+// Menu background and save preview at device size. Built from the last core
+// frame we already have on the cpu side, the full gpu readback is only paid
+// when the shaded screen was asked for (or no frame has been seen yet).
+// the last core frame only stands in for the screen when what was presented
+// is a plain fullscreen or aspect scale of it. other scaling modes, offsets,
+// rotation, shaders, overlays and effects only exist on screen, and the
+// debug hud is drawn into the frame itself, so those read the screen back
+static int Menu_frameMatchesScreen(void) {
+	return !menu_shader_bg && lastframe && lastframe_w && lastframe_h
+		&& (screen_scaling==SCALE_FULLSCREEN || screen_scaling==SCALE_ASPECT)
+		&& !should_rotate && screenx==64 && screeny==64
+		&& !show_debug && screen_effect==EFFECT_NONE && !overlay
+		&& config.shaders.options[SH_NROFSHADERS].value==0;
+}
+
+static int menu_bg_from_frame = 0;
+static SDL_Surface* Menu_captureBackground(void) {
+	menu_bg_from_frame = Menu_frameMatchesScreen();
+	if (menu_bg_from_frame) {
+		// the core frame is swizzled at its own size first, so the stretch
+		// to the screen is a same-format SDL_SoftStretch and not the
+		// per-pixel converting blit
+		SDL_Surface* raw = SDL_CreateRGBSurfaceWithFormatFrom(
+			(void*)lastframe, lastframe_w, lastframe_h, 32, lastframe_w * 4, SDL_PIXELFORMAT_ABGR8888
+		);
+		SDL_Surface* frame = raw ? SDL_ConvertSurfaceFormat(raw, SDL_PIXELFORMAT_RGBA8888, 0) : NULL;
+		if (raw) SDL_FreeSurface(raw);
+		SDL_Surface* bitmap = SDL_CreateRGBSurfaceWithFormat(0, DEVICE_WIDTH, DEVICE_HEIGHT, 32, SDL_PIXELFORMAT_RGBA8888);
+		if (frame && bitmap) {
+			SDL_SetSurfaceBlendMode(frame, SDL_BLENDMODE_NONE);
+			SDL_FillRect(bitmap, NULL, SDL_MapRGBA(bitmap->format, 0, 0, 0, 255));
+
+			SDL_Rect dst = {0, 0, DEVICE_WIDTH, DEVICE_HEIGHT};
+			if (screen_scaling!=SCALE_FULLSCREEN && core.aspect_ratio>0) {
+				dst.h = DEVICE_WIDTH / core.aspect_ratio;
+				if (dst.h>DEVICE_HEIGHT) {
+					dst.h = DEVICE_HEIGHT;
+					dst.w = DEVICE_HEIGHT * core.aspect_ratio;
+				}
+				dst.x = (DEVICE_WIDTH - dst.w) / 2;
+				dst.y = (DEVICE_HEIGHT - dst.h) / 2;
+			}
+			SDL_BlitScaled(frame, NULL, bitmap, &dst);
+			SDL_FreeSurface(frame);
+			return bitmap;
+		}
+		if (frame) SDL_FreeSurface(frame);
+		if (bitmap) SDL_FreeSurface(bitmap);
+		menu_bg_from_frame = 0;
+	}
 
 	int cw, ch;
 	unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
-	
-	renderer.dst = pixels;
 	SDL_Surface* rawSurface = SDL_CreateRGBSurfaceWithFormatFrom(
 		pixels, cw, ch, 32, cw * 4, SDL_PIXELFORMAT_ABGR8888
 	);
 	SDL_Surface* converted = SDL_ConvertSurfaceFormat(rawSurface, SDL_PIXELFORMAT_RGBA8888, 0);
 	SDL_FreeSurface(rawSurface);
 	free(pixels); 
+	return converted;
+}
 
-	menu.bitmap = converted;
+static void Menu_loop(void) {
+	uint64_t menu_open_start = getMicroseconds();
+	Latency_cancel(); // a press that opened the menu isn't a game frame
+	menu.bitmap = Menu_captureBackground();
 	SDL_Surface* backing = SDL_CreateRGBSurfaceWithFormat(0,DEVICE_WIDTH,DEVICE_HEIGHT,32,SDL_PIXELFORMAT_RGBA8888); 
 	
 
@@ -6877,6 +7503,10 @@ static void Menu_loop(void) {
 			}
 			GFX_flip(screen);
 			dirty=0;
+			if (menu_open_start) {
+				LOG_info("menu open took %lluus (%s)\n", (unsigned long long)(getMicroseconds() - menu_open_start), menu_bg_from_frame ? "last frame" : "screen readback");
+				menu_open_start = 0;
+			}
 		} else {
 			// please dont flip cause it will cause current_fps dip and audio is weird first seconds
 			GFX_delay();
@@ -7043,7 +7673,194 @@ void onAudioSinkChanged(int device, int watch_event)
 		LOG_error("asoundrc is not deleted yet!!!\n");
 }
 
+///////////////////////////////////////
+// warm start
+
+// MinUI.pak starts `minarch.elf --warm` in the background as soon as
+// nextui exits for an Emus pak. It starts listening on WARM_SOCKET_PATH
+// right away, runs everything that doesn't depend on the game and only
+// then accepts. The regular `minarch.elf core rom` from the pak's
+// launch.sh connects, hands over its paths, cwd and stdio and waits for
+// the parked process to finish the game.
+
+#define WARM_SOCKET_PATH "/tmp/minarch.sock"
+#define WARM_PENDING_PATH "/tmp/minarch.warm" // touched by MinUI.pak before it spawns us
+#define WARM_PARK_TIMEOUT 10000 // ms, give up if nobody launches a game
+#define WARM_CONNECT_TRIES 100 // 10ms apart, covers the spawn before we listen
+
+static int warm_listener = -1;
+static int warm_client = -1; // kept open until we exit, its EOF releases the launcher
+
+static int Warm_connect(void) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	strncpy(addr.sun_path, WARM_SOCKET_PATH, sizeof(addr.sun_path)-1);
+
+	for (int i=0; i<WARM_CONNECT_TRIES; i++) {
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd<0) return -1;
+		if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))==0) return fd;
+		close(fd);
+		// only wait for a warm instance that is known to be on its way
+		if (!exists(WARM_PENDING_PATH)) return -1;
+		usleep(10000);
+	}
+	return -1;
+}
+
+// returns 1 if a parked minarch took the launch and has since finished
+static int Warm_handoff(char* core_path, char* rom_path) {
+	int fd = Warm_connect();
+	if (fd<0) return 0;
+
+	char cwd[MAX_PATH] = {0};
+	if (!getcwd(cwd, sizeof(cwd))) cwd[0] = '\0';
+	char request[MAX_PATH * 3];
+	int len = snprintf(request, sizeof(request), "%s%c%s%c%s", core_path,'\0', rom_path,'\0', cwd) + 1;
+
+	// stdout/stderr carry the pak's log redirect, the parked process adopts them
+	int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+	char control[CMSG_SPACE(sizeof(fds))] = {0};
+	struct iovec iov = {.iov_base = request, .iov_len = len};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control),
+	};
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if (sendmsg(fd, &msg, 0)!=len) {
+		close(fd);
+		return 0;
+	}
+
+	// nothing ever comes back, the socket just closes when the game does
+	char byte;
+	while (read(fd, &byte, 1)>0 || errno==EINTR);
+	close(fd);
+	return 1;
+}
+
+static void Warm_stopListening(void) {
+	if (warm_listener<0) return;
+	unlink(WARM_SOCKET_PATH);
+	close(warm_listener);
+	warm_listener = -1;
+	unlink(WARM_PENDING_PATH);
+}
+
+// connections queue up in the backlog until Warm_park accepts them
+static int Warm_listen(void) {
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd<0) return 0;
+
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	strncpy(addr.sun_path, WARM_SOCKET_PATH, sizeof(addr.sun_path)-1);
+	unlink(WARM_SOCKET_PATH);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr))<0 || listen(fd, 1)<0) {
+		close(fd);
+		unlink(WARM_PENDING_PATH);
+		return 0;
+	}
+	warm_listener = fd;
+	return 1;
+}
+
+// returns 1 with the paths filled in once a launcher hands over a game
+static int Warm_park(char* core_path, char* rom_path) {
+	LOG_info("warm start: parked after %ims\n", SDL_GetTicks());
+
+	struct pollfd pfd = {.fd = warm_listener, .events = POLLIN};
+	if (poll(&pfd, 1, WARM_PARK_TIMEOUT)>0) {
+		warm_client = accept(warm_listener, NULL, NULL);
+		if (warm_client>=0) fcntl(warm_client, F_SETFD, FD_CLOEXEC);
+	}
+	// one game per process, a second launcher falls back to a cold start
+	Warm_stopListening();
+	if (warm_client<0) {
+		LOG_info("warm start: nobody launched a game\n");
+		return 0;
+	}
+
+	char request[MAX_PATH * 3] = {0};
+	int fds[3] = {-1,-1,-1};
+	char control[CMSG_SPACE(sizeof(fds))] = {0};
+	struct iovec iov = {.iov_base = request, .iov_len = sizeof(request)-1};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = control,
+		.msg_controllen = sizeof(control),
+	};
+	int len = recvmsg(warm_client, &msg, MSG_CMSG_CLOEXEC);
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_type==SCM_RIGHTS && cmsg->cmsg_len==CMSG_LEN(sizeof(fds)))
+		memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+	int ok = 0;
+	char* core = request;
+	char* rom = core + strlen(core) + 1;
+	char* cwd = rom < request + len ? rom + strlen(rom) + 1 : NULL;
+	if (len>0 && cwd && cwd < request + len) {
+		strcpy(core_path, core);
+		strcpy(rom_path, rom);
+		if (*cwd) chdir(cwd);
+		ok = 1;
+	}
+
+	for (int i=0; i<3; i++) {
+		if (fds[i]<0) continue;
+		if (ok) dup2(fds[i], i);
+		close(fds[i]);
+	}
+	return ok;
+}
+
+// the exit fade presents the last frame again under the transition pass
+// on its own thread, so the core unloads and sram is written while it
+// runs instead of after it. only power and video teardown wait for it
+static SDL_Thread* exit_fade_thread = NULL;
+static int exit_fade_frames = 1;
+static int ExitFade_thread(void* arg) {
+	PWR_registerThread(THREAD_PROFILE_RENDER);
+	GFX_GL_setCurrent(1);
+	GFX_blitRenderer(&renderer);
+	for (int i=exit_fade_frames-1; i>=0; i--) {
+		GFX_GL_setTransition(TRANSITION_FADE, (float)i / exit_fade_frames);
+		GFX_GL_Swap();
+	}
+	GFX_GL_setTransition(TRANSITION_NONE, 1.0f);
+	GFX_GL_setCurrent(0);
+	PWR_unregisterThread();
+	return 0;
+}
+static void ExitFade_start(void) {
+	if (!renderer.src) return;
+
+	exit_fade_frames = CFG_getMenuTransitions() ? 12 : 1;
+	GFX_GL_setCurrent(0);
+	exit_fade_thread = SDL_CreateThread(ExitFade_thread, "ExitFade", NULL);
+	if (!exit_fade_thread) GFX_GL_setCurrent(1); // just cut to black
+}
+static void ExitFade_wait(void) {
+	if (!exit_fade_thread) return;
+	SDL_WaitThread(exit_fade_thread, NULL);
+	exit_fade_thread = NULL;
+	GFX_GL_setCurrent(1);
+}
+
 int main(int argc , char* argv[]) {
+	uint64_t launched_at = getMicroseconds();
+	int warm = argc>=2 && exactMatch(argv[1], "--warm");
+	if (warm && !Warm_listen())
+		return EXIT_FAILURE;
+	if (!warm && argc>=3 && Warm_handoff(argv[1], argv[2]))
+		return EXIT_SUCCESS;
+
 	LOG_info("MinArch\n");
 
 	static char asoundpath[MAX_PATH];
@@ -7066,14 +7883,14 @@ int main(int argc , char* argv[]) {
 	char rom_path[MAX_PATH]; 
 	char tag_name[MAX_PATH];
 
-	if(argc < 2)
+	if(!warm && argc < 3)
 		return EXIT_FAILURE;
 
-	strcpy(core_path, argv[1]);
-	strcpy(rom_path, argv[2]);
-	getEmuName(rom_path, tag_name);
-	
-	LOG_info("rom_path: %s\n", rom_path);
+	if (!warm) {
+		strcpy(core_path, argv[1]);
+		strcpy(rom_path, argv[2]);
+		LOG_info("rom_path: %s\n", rom_path);
+	}
 	
 	screen = GFX_init(MODE_MENU);
 
@@ -7093,6 +7910,13 @@ int main(int argc , char* argv[]) {
 		PWR_disableSleep();
 	MSG_init();
 	IMG_Init(IMG_INIT_PNG);
+
+	if (warm) {
+		if (!Warm_park(core_path, rom_path)) goto finish;
+		launched_at = getMicroseconds();
+		LOG_info("rom_path: %s\n", rom_path);
+	}
+	getEmuName(rom_path, tag_name);
 	Core_open(core_path, tag_name);
 
 	fmt = RETRO_PIXEL_FORMAT_XRGB8888;
@@ -7162,15 +7986,25 @@ int main(int argc , char* argv[]) {
 	Config_free();
 
 	LOG_info("total startup time %ims\n\n",SDL_GetTicks());
+	PWR_registerThread(THREAD_PROFILE_EMULATION); // this thread runs the core
+	int first_frame = 1;
 	while (!quit) {
 		GFX_startFrame();
+		Pipeline_resume();
 	
 		core.run();
+		if (first_frame) {
+			first_frame = 0;
+			LOG_info("time to first frame: %llums (%s start)\n", (unsigned long long)(getMicroseconds() - launched_at) / 1000, warm ? "warm" : "cold");
+		}
+		Input_tick();
 		limitFF();
 		trackFPS();
+		collectScreenCapture(0);
 		
 
 		if (has_pending_opt_change) {
+			Pipeline_pause();
 			has_pending_opt_change = 0;
 			if (Core_updateAVInfo()) {
 				LOG_info("AV info changed, reset sound system");
@@ -7182,6 +8016,7 @@ int main(int argc , char* argv[]) {
 
 		
 		if (show_menu) {
+			Pipeline_pause();
 			PWR_updateFrequency(PWR_UPDATE_FREQ,1);
 			Menu_loop();
 			PWR_updateFrequency(PWR_UPDATE_FREQ_INGAME,0);
@@ -7198,21 +8033,12 @@ int main(int argc , char* argv[]) {
 
 		hdmimon();
 	}
-	int cw, ch;
-	unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
-	
-	renderer.dst = pixels;
-	SDL_Surface* rawSurface = SDL_CreateRGBSurfaceWithFormatFrom(
-		pixels, cw, ch, 32, cw * 4, SDL_PIXELFORMAT_ABGR8888
-	);
-	SDL_Surface* converted = SDL_ConvertSurfaceFormat(rawSurface, SDL_PIXELFORMAT_RGBA8888, 0);
-	screen = converted;
-	SDL_FreeSurface(rawSurface);
-	free(pixels); 
-	GFX_animateSurfaceOpacity(converted, 0, 0, cw, ch, 255, 0, CFG_getMenuTransitions() ? 200 : 20, 1);
-	SDL_FreeSurface(converted); 
-	
-	if(rgbaData) free(rgbaData);
+	Pipeline_quit();
+	collectScreenCapture(1);
+	Latency_save();
+	PAD_setTimestamps(0);
+
+	ExitFade_start();
 
 	PLAT_clearTurbo();
 
@@ -7228,6 +8054,8 @@ finish:
 	Config_quit();
 	Special_quit();
 	MSG_quit();
+	ExitFade_wait();
+	if (rgbaData) free(rgbaData); // the fade draws from it
 	PWR_quit();
 	VIB_quit();
 	SND_removeDeviceWatcher();
@@ -15,6 +15,8 @@
 #include <pthread.h>
 #include <assert.h>
 #include <limits.h>
+#include <time.h>
+#include <poll.h>
 
 ///////////////////////////////////////
 
@@ -1721,6 +1723,15 @@ int needDraw = 0;
 int folderbgchanged=0;
 int thumbchanged=0;
 
+// the main loop sleeps in poll() while idle, the loader threads write to
+// this pipe so a finished background or thumbnail is still drawn right away
+static int wake_pipe[2] = {-1,-1};
+static void wakeMainLoop(void) {
+	if (wake_pipe[1]<0) return;
+	char byte = 0;
+	write(wake_pipe[1], &byte, 1); // a full pipe already wakes the loop
+}
+
 // queue a new image load task :D
 #define MAX_QUEUE_SIZE 1
 
@@ -1888,11 +1899,13 @@ void onBackgroundLoaded(SDL_Surface* surface) {
     if (!surface) {
 		folderbgbmp = NULL;
 		SDL_UnlockMutex(bgMutex);
+		wakeMainLoop();
 		return;
 	}
     folderbgbmp = surface;
 	needDraw = 1;
 	SDL_UnlockMutex(bgMutex);
+	wakeMainLoop();
 }
 
 void startLoadThumb(const char* thumbpath, BackgroundLoadedCallback callback, void* userData) {
@@ -1911,6 +1924,7 @@ void onThumbLoaded(SDL_Surface* surface) {
     if (!surface) {
 		thumbbmp = NULL;
 		SDL_UnlockMutex(thumbMutex);
+		wakeMainLoop();
 		return;
 	}
   
@@ -1935,6 +1949,7 @@ void onThumbLoaded(SDL_Surface* surface) {
 	);
 	needDraw = 1;
 	SDL_UnlockMutex(thumbMutex);
+	wakeMainLoop();
 }
 
 SDL_Rect pillRect;
@@ -1974,6 +1989,7 @@ void animcallback(finishedTask *task) {
 	}
 	SDL_UnlockMutex(animMutex);
 	animationDraw = 1;
+	wakeMainLoop();
 }
 bool frameReady = true;
 bool pillanimdone = false;
@@ -2099,6 +2115,150 @@ void initImageLoaderPool() {
 }
 ///////////////////////////////////////
 
+///////////////////////////////////////
+
+// when nothing is animating, scrolling or held the main loop sleeps until
+// input arrives, a worker writes wake_pipe or the nearest deadline passes:
+// the next minute for the clock, the battery poll or autosleep.
+// SDL_WaitEventTimeout can't do this here, with joysticks open SDL2 falls
+// back to pumping events every millisecond. Instead the loop polls its own
+// descriptors for the evdev nodes SDL reads from, each open file has its
+// own event queue so draining ours leaves SDL's untouched.
+#define IDLE_FRAME_MS	17
+#define IDLE_LINGER_MS	1000 // keep polling a little after activity, keymon applies settings late
+#define IDLE_BATTERY_MS	5000 // how often the battery thread refreshes
+#define IDLE_MAX_FDS	16
+
+static struct {
+	uint32_t input_at;
+	uint32_t active_at;
+	uint32_t window_start;
+	struct pollfd fds[IDLE_MAX_FDS]; // wake_pipe first, then the input devices
+	int fd_count;
+	int input_count;
+	int passes;
+	long switches_at;
+	int passes_per_minute;
+	long switches_per_minute;
+	int total_passes;
+	long total_switches;
+} idle;
+
+// the main thread's real sleeps, loop passes alone would hide any
+// wakeups that happen inside a library call
+static long Idle_contextSwitches(void) {
+	FILE* file = fopen("/proc/thread-self/status", "r");
+	if (!file) return -1;
+	char line[256];
+	long total = -1;
+	while (fgets(line, sizeof(line), file)) {
+		long count;
+		if (sscanf(line, "voluntary_ctxt_switches: %ld", &count)==1 ||
+			sscanf(line, "nonvoluntary_ctxt_switches: %ld", &count)==1) {
+			total = (total<0 ? 0 : total) + count;
+		}
+	}
+	fclose(file);
+	return total;
+}
+
+static void Idle_init(void) {
+	idle.fd_count = 0;
+	idle.input_count = 0;
+	if (pipe(wake_pipe)==0) {
+		for (int i=0; i<2; i++) {
+			fcntl(wake_pipe[i], F_SETFL, fcntl(wake_pipe[i], F_GETFL) | O_NONBLOCK);
+			fcntl(wake_pipe[i], F_SETFD, FD_CLOEXEC);
+		}
+		idle.fds[idle.fd_count++] = (struct pollfd){ .fd = wake_pipe[0], .events = POLLIN };
+	}
+	else LOG_warn("idle: no wake pipe, loader threads can't wake the main loop\n");
+
+	DIR* dir = opendir("/dev/input");
+	if (dir) {
+		struct dirent* dp;
+		while ((dp = readdir(dir)) && idle.fd_count<IDLE_MAX_FDS) {
+			if (!prefixMatch("event", dp->d_name)) continue;
+			char path[256];
+			snprintf(path, sizeof(path), "/dev/input/%s", dp->d_name);
+			int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			if (fd<0) continue;
+			idle.fds[idle.fd_count++] = (struct pollfd){ .fd = fd, .events = POLLIN };
+			idle.input_count += 1;
+		}
+		closedir(dir);
+	}
+	// without input to poll the loop can't sleep past a frame
+	if (!idle.input_count) LOG_info("idle: no readable input devices, waiting a frame at a time\n");
+
+	idle.switches_at = Idle_contextSwitches();
+}
+
+static void Idle_quit(void) {
+	for (int i=0; i<idle.fd_count; i++) {
+		if (idle.fds[i].fd>=0 && idle.fds[i].fd!=wake_pipe[0]) close(idle.fds[i].fd);
+	}
+	idle.fd_count = 0;
+	if (wake_pipe[0]>=0) close(wake_pipe[0]);
+	if (wake_pipe[1]>=0) close(wake_pipe[1]);
+	wake_pipe[0] = wake_pipe[1] = -1;
+}
+
+static void Idle_countWakeup(uint32_t now) {
+	idle.passes += 1;
+	idle.total_passes += 1;
+	if (!idle.window_start) idle.window_start = now;
+	if (now - idle.window_start >= 60000) {
+		uint32_t elapsed = now - idle.window_start;
+		long switches = Idle_contextSwitches();
+		idle.passes_per_minute = (int)((uint64_t)idle.passes * 60000 / elapsed);
+		idle.switches_per_minute = -1;
+		if (switches>=0 && idle.switches_at>=0) {
+			idle.switches_per_minute = (long)((uint64_t)(switches - idle.switches_at) * 60000 / elapsed);
+			idle.total_switches += switches - idle.switches_at;
+		}
+		LOG_debug("main loop: %i passes/min, %li wakeups/min\n", idle.passes_per_minute, idle.switches_per_minute);
+		idle.passes = 0;
+		idle.switches_at = switches;
+		idle.window_start = now;
+	}
+}
+
+static void Idle_wait(uint32_t now, int deep) {
+	int timeout = IDLE_FRAME_MS;
+	if (deep && idle.input_count) {
+		timeout = (int)(60 - time(NULL) % 60) * 1000;
+		if (timeout > IDLE_BATTERY_MS) timeout = IDLE_BATTERY_MS;
+
+		int screen_off = CFG_getScreenTimeoutSecs() * 1000;
+		if (screen_off > 0) {
+			int remaining = (int)(idle.input_at + screen_off - now);
+			// once past the deadline PWR_update owns it, don't spin on it
+			if (remaining > 0 && remaining < timeout) timeout = remaining;
+		}
+	}
+	// nothing is drained before polling, an event that landed after PAD_poll
+	// must still wake us. events read by SDL in the meantime cost one
+	// extra pass through the loop at most.
+	if (poll(idle.fds, idle.fd_count, timeout)<=0) return;
+
+	char buffer[256];
+	for (int i=0; i<idle.fd_count; i++) {
+		struct pollfd* pfd = &idle.fds[i];
+		if (pfd->revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			if (pfd->fd!=wake_pipe[0]) {
+				// unplugged, poll() skips negative descriptors
+				close(pfd->fd);
+				pfd->fd = -1;
+				idle.input_count -= 1;
+			}
+		}
+		else if (pfd->revents & POLLIN) {
+			while (read(pfd->fd, buffer, sizeof(buffer))>0);
+		}
+	}
+}
+
 int main (int argc, char *argv[]) {
 	// LOG_info("time from launch to:\n");
 	// unsigned long main_begin = SDL_GetTicks();
@@ -2112,6 +2272,7 @@ int main (int argc, char *argv[]) {
 	InitSettings();
 	
 	screen = GFX_init(MODE_MAIN);
+	Idle_init(); // before the loader threads, they write its wake pipe
 	// LOG_info("- graphics init: %lu\n", SDL_GetTicks() - main_begin);
 	
 	PAD_init();
@@ -2179,17 +2340,35 @@ int main (int argc, char *argv[]) {
 	static int globallpillW = 0;
 	SDL_UnlockMutex(animMutex);
 
+	int shader_warmup = 1;
+	int idle_frames = 0;
+	idle.input_at = idle.active_at = SDL_GetTicks();
+
 	//LOG_info("Start time time %ims\n",SDL_GetTicks());
 	while (!quit) {
 		GFX_startFrame();
 		unsigned long now = SDL_GetTicks();
+		int idle_pass = 0;
+		Idle_countWakeup(now);
 		
 		PAD_poll();
+		if (PAD_anyPressed() || PAD_anyJustReleased()) {
+			idle_frames = 0;
+			idle.input_at = now;
+		}
 			
 		int selected = top->selected;
 		int total = top->entries->count;
 		
 		PWR_update(&dirty, &show_setting, NULL, NULL);
+
+		// nothing else redraws while idle, so the clock asks for it
+		static time_t clock_minute = 0;
+		time_t minute = time(NULL) / 60;
+		if (minute != clock_minute) {
+			if (clock_minute && CFG_getShowClock()) dirty = 1;
+			clock_minute = minute;
+		}
 		
 		int is_online = PLAT_isOnline();
 		if (was_online!=is_online) 
@@ -3164,7 +3343,7 @@ int main (int argc, char *argv[]) {
 				} 
 			}
 			else {
-				SDL_Delay(100); // why are we running long delays on the render thread, wtf?
+				idle_pass = 1;
 			}
 			dirty = 0;
 		} 
@@ -3176,10 +3355,15 @@ int main (int argc, char *argv[]) {
 			if(needDraw) {
 				PLAT_GPU_Flip();
 				needDraw = 0;
+			} else if (shader_warmup && ++idle_frames > 120) {
+				// after ~2s without input, fill the shader cache one program at a time
+				// so the first launch of a game doesn't pay for compiling its preset.
+				// still waits a frame after each one, input that arrives during a
+				// compile is handled before the next
+				shader_warmup = GFX_warmShaderCache();
+				idle_pass = 1;
 			} else {
-				// TODO: Why 17? Seems like an odd choice for 60fps, it almost guarantees we miss at least one frame.
-				// This should either be 16(.66666667) or make proper use of SDL_Ticks to only wait for the next render pass.
-				SDL_Delay(17); 
+				idle_pass = 1;
 			}
 			SDL_UnlockMutex(animqueueMutex);
 			SDL_UnlockMutex(thumbqueueMutex);
@@ -3208,7 +3392,20 @@ int main (int argc, char *argv[]) {
 			sleep(4);
 			quit = 1;
 		}
+
+		// waits outside the queue locks so the workers can finish meanwhile
+		if (!idle_pass) {
+			idle.active_at = now;
+		}
+		else if (!quit) {
+			int deep = !shader_warmup && !show_setting && !PAD_anyPressed() && currentAnimQueueSize < 1 &&
+				now - idle.active_at >= IDLE_LINGER_MS;
+			Idle_wait(now, deep);
+		}
 	}
+	Idle_quit();
+	LOG_info("main loop: %i passes, %li wakeups, %i passes/%li wakeups per min in the last full minute\n",
+		idle.total_passes, idle.total_switches, idle.passes_per_minute, idle.switches_per_minute);
 	if(blackBG)	SDL_FreeSurface(blackBG);
 	if (folderbgbmp) SDL_FreeSurface(folderbgbmp);
 	if (thumbbmp) SDL_FreeSurface(thumbbmp);
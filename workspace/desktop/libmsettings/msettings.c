@@ -343,6 +343,13 @@ int InitializedSettings(void){
 	return msettings != NULL;
 }
 
+// nothing else writes the settings here, so nothing ever changes
+unsigned int GetSettingsGeneration(void) { return 0; }
+int WaitSettingsChange(unsigned int generation, int timeout_ms) {
+	if (timeout_ms >= 0) usleep(timeout_ms * 1000);
+	return 0;
+}
+
 // not implemented here
 
 int GetBrightness(void) { return 0; }
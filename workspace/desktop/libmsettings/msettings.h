@@ -15,6 +15,12 @@ void InitSettings(void);
 void QuitSettings(void);
 int InitializedSettings(void);
 
+// bumped by every setter in any process, cheap enough to poll each frame
+unsigned int GetSettingsGeneration(void);
+// blocks until the generation moves past the given one or the timeout
+// (-1 waits forever) expires, returns 1 if it changed
+int WaitSettingsChange(unsigned int generation, int timeout_ms);
+
 int GetBrightness(void);
 int GetColortemp(void);
 int GetContrast(void);
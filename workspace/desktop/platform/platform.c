@@ -56,6 +56,17 @@ typedef struct Shader {
 GLuint g_shader_default = 0;
 GLuint g_shader_overlay = 0;
 GLuint g_noshader = 0;
+GLuint g_shader_transition = 0;
+
+// startup fades and reveals are a black pass blended over the finished
+// frame, minarch only advances progress so the core's buffer is untouched
+static struct {
+	int type;
+	float progress;
+	GLint u_Progress;
+	GLint u_Mode;
+	Shader shader;
+} transition;
 
 Shader* shaders[MAXSHADERS] = {
     &(Shader){ .shader_p = 0, .scale = 1, .filter = GL_LINEAR, .scaletype = 1, .srctype = 0, .filename ="stock.glsl", .texture = 0, .updated = 1 },
@@ -77,6 +88,46 @@ void PLAT_quitInput(void) {
 	SDL_QuitSubSystem(SDL_INIT_JOYSTICK);
 }
 
+// synthetic input for latency probing without hands, eg. in CI:
+// MINARCH_INJECT_INPUT=500 taps A every 500ms while probing is on
+static SDL_Thread* inject_thread;
+static SDL_atomic_t inject_running;
+static volatile uint64_t inject_at;
+static int injectInput(void* arg) {
+	int interval = *(int*)arg;
+	while (SDL_AtomicGet(&inject_running)) {
+		SDL_Event event = {0};
+		event.type = SDL_KEYDOWN;
+		event.key.keysym.scancode = CODE_A;
+		inject_at = getMicroseconds();
+		SDL_PushEvent(&event);
+		SDL_Delay(interval / 2);
+		event.type = SDL_KEYUP;
+		SDL_PushEvent(&event);
+		SDL_Delay(interval - interval / 2);
+	}
+	return 0;
+}
+void PLAT_setInputTimestamps(int enable) {
+	static int interval;
+	if (enable && !inject_thread) {
+		char* env = getenv("MINARCH_INJECT_INPUT");
+		interval = env ? atoi(env) : 0;
+		if (interval<20) return;
+		LOG_info("injecting A every %ims\n", interval);
+		SDL_AtomicSet(&inject_running, 1);
+		inject_thread = SDL_CreateThread(injectInput, "injectInput", &interval);
+	}
+	else if (!enable && inject_thread) {
+		SDL_AtomicSet(&inject_running, 0);
+		SDL_WaitThread(inject_thread, NULL);
+		inject_thread = NULL;
+	}
+}
+uint64_t PLAT_getInputTimestamp(void) {
+	return inject_thread ? inject_at : 0;
+}
+
 ///////////////////////////////
 
 static struct VID_Context {
@@ -389,6 +440,18 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
     return shader;
 }
 
+static void initTransitionShader(void) {
+	// only OutputSize goes through runShaderPass, the rest is set per frame
+	transition.shader = (Shader){
+		.texw = device_width, .texh = device_height,
+		.u_FrameDirection = -1, .u_FrameCount = -1, .u_TextureSize = -1,
+		.u_InputSize = -1, .OrigInputSize = -1, .texLocation = -1, .texelSizeLocation = -1,
+	};
+	transition.shader.u_OutputSize = glGetUniformLocation(g_shader_transition, "OutputSize");
+	transition.u_Progress = glGetUniformLocation(g_shader_transition, "Progress");
+	transition.u_Mode = glGetUniformLocation(g_shader_transition, "Mode");
+}
+
 void PLAT_initShaders() {
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 	glViewport(0, 0, device_width, device_height);
@@ -407,6 +470,11 @@ void PLAT_initShaders() {
 	vertex = load_shader_from_file(GL_VERTEX_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
 	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
 	g_noshader = link_program(vertex, fragment,"noshader.glsl");
+
+	vertex = load_shader_from_file(GL_VERTEX_SHADER, "transition.glsl",SYSSHADERS_FOLDER);
+	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "transition.glsl",SYSSHADERS_FOLDER);
+	g_shader_transition = link_program(vertex, fragment,"transition.glsl");
+	initTransitionShader();
 	
 	LOG_info("default shaders loaded, %i\n\n",g_shader_default);
 }
@@ -668,6 +736,7 @@ static void clearVideo(void) {
 	}
 }
 
+
 void PLAT_quitVideo(void) {
 	clearVideo();
 
@@ -683,6 +752,7 @@ void PLAT_quitVideo(void) {
 	if (vid.target_layer2) SDL_DestroyTexture(vid.target_layer2);
 	if (vid.target_layer4) SDL_DestroyTexture(vid.target_layer4);
 	if (vid.target_layer5) SDL_DestroyTexture(vid.target_layer5);
+	TexPool_quit();
 	if (overlay_path) free(overlay_path);
 	SDL_DestroyTexture(vid.stream_layer1);
 	SDL_DestroyRenderer(vid.renderer);
@@ -957,20 +1027,14 @@ void PLAT_clearLayers(int layer) {
 
 	SDL_SetRenderTarget(vid.renderer, NULL);
 }
+
 void PLAT_drawOnLayer(SDL_Surface *inputSurface, int x, int y, int w, int h, float brightness, bool maintainAspectRatio,int layer) {
     if (!inputSurface || !vid.target_layer1 || !vid.renderer) return; 
 
-    SDL_Texture* tempTexture = SDL_CreateTexture(vid.renderer,
-                                                 SDL_PIXELFORMAT_RGBA8888, 
-                                                 SDL_TEXTUREACCESS_TARGET,  
-                                                 inputSurface->w, inputSurface->h); 
+    PooledTexture* pooled = TexPool_acquire(vid.renderer, inputSurface);
+    if (!pooled) return;
+    SDL_Texture* tempTexture = pooled->texture;
 
-    if (!tempTexture) {
-        printf("Failed to create temporary texture: %s\n", SDL_GetError());
-        return;
-    }
-
-    SDL_UpdateTexture(tempTexture, NULL, inputSurface->pixels, inputSurface->pitch);
     switch (layer)
 	{
 	case 1:
@@ -1019,7 +1083,7 @@ void PLAT_drawOnLayer(SDL_Surface *inputSurface, int x, int y, int w, int h, flo
 
     SDL_RenderCopy(vid.renderer, tempTexture, &srcRect, &dstRect);
     SDL_SetRenderTarget(vid.renderer, NULL);
-    SDL_DestroyTexture(tempTexture);
+    TexPool_release(pooled);
 }
 
 
@@ -1035,17 +1099,9 @@ void PLAT_animateSurface(
 ) {
 	if (!inputSurface || !vid.target_layer2 || !vid.renderer) return;
 
-	SDL_Texture* tempTexture = SDL_CreateTexture(vid.renderer,
-		SDL_PIXELFORMAT_RGBA8888,
-		SDL_TEXTUREACCESS_TARGET,
-		inputSurface->w, inputSurface->h);
-
-	if (!tempTexture) {
-		printf("Failed to create temporary texture: %s\n", SDL_GetError());
-		return;
-	}
-
-	SDL_UpdateTexture(tempTexture, NULL, inputSurface->pixels, inputSurface->pitch);
+	PooledTexture* pooled = TexPool_acquire(vid.renderer, inputSurface);
+	if (!pooled) return;
+	SDL_Texture* tempTexture = pooled->texture;
 	SDL_SetTextureBlendMode(tempTexture, SDL_BLENDMODE_BLEND);  // Enable blending for opacity
 
 	const int fps = 60;
@@ -1082,7 +1138,7 @@ void PLAT_animateSurface(
 		PLAT_GPU_Flip();
 	}
 
-	SDL_DestroyTexture(tempTexture);
+	TexPool_release(pooled);
 }
 
 static int text_offset = 0;
@@ -1190,17 +1246,9 @@ void PLAT_animateSurfaceOpacity(
 ) {
 	if (!inputSurface) return;
 
-	SDL_Texture* tempTexture = SDL_CreateTexture(vid.renderer,
-		SDL_PIXELFORMAT_RGBA8888,
-		SDL_TEXTUREACCESS_TARGET,
-		inputSurface->w, inputSurface->h);
-
-	if (!tempTexture) {
-		printf("Failed to create temporary texture: %s\n", SDL_GetError());
-		return;
-	}
-
-	SDL_UpdateTexture(tempTexture, NULL, inputSurface->pixels, inputSurface->pitch);
+	PooledTexture* pooled = TexPool_acquire(vid.renderer, inputSurface);
+	if (!pooled) return;
+	SDL_Texture* tempTexture = pooled->texture;
 	SDL_SetTextureBlendMode(tempTexture, SDL_BLENDMODE_BLEND); 
 
 	const int fps = 60;
@@ -1209,7 +1257,7 @@ void PLAT_animateSurfaceOpacity(
 
 	SDL_Texture* target_layer = (layer == 0) ? vid.target_layer2 : vid.target_layer4;
 	if (!target_layer) {
-		SDL_DestroyTexture(tempTexture);
+		TexPool_release(pooled);
 		return;
 	}
 
@@ -1235,7 +1283,7 @@ void PLAT_animateSurfaceOpacity(
 
 	}
 
-	SDL_DestroyTexture(tempTexture);
+	TexPool_release(pooled);
 }
 
 SDL_Surface* PLAT_captureRendererToSurface() {
@@ -1282,26 +1330,19 @@ void PLAT_animateAndFadeSurface(
 ) {
 	if (!inputSurface || !vid.renderer) return;
 
-	SDL_Texture* moveTexture = SDL_CreateTexture(vid.renderer,
-		SDL_PIXELFORMAT_RGBA8888,
-		SDL_TEXTUREACCESS_TARGET,
-		inputSurface->w, inputSurface->h);
-
-	if (!moveTexture) {
-		printf("Failed to create move texture: %s\n", SDL_GetError());
-		return;
-	}
-
-	SDL_UpdateTexture(moveTexture, NULL, inputSurface->pixels, inputSurface->pitch);
+	PooledTexture* pooledMove = TexPool_acquire(vid.renderer, inputSurface);
+	if (!pooledMove) return;
+	SDL_Texture* moveTexture = pooledMove->texture;
 
+	PooledTexture* pooledFade = NULL;
 	SDL_Texture* fadeTexture = NULL;
 	if (fadeSurface) {
-		fadeTexture = SDL_CreateTextureFromSurface(vid.renderer, fadeSurface);
-		if (!fadeTexture) {
-			printf("Failed to create fade texture: %s\n", SDL_GetError());
-			SDL_DestroyTexture(moveTexture);
+		pooledFade = TexPool_acquire(vid.renderer, fadeSurface);
+		if (!pooledFade) {
+			TexPool_release(pooledMove);
 			return;
 		}
+		fadeTexture = pooledFade->texture;
 		SDL_SetTextureBlendMode(fadeTexture, SDL_BLENDMODE_BLEND);
 	}
 
@@ -1361,8 +1402,8 @@ void PLAT_animateAndFadeSurface(
 
 	}
 
-	SDL_DestroyTexture(moveTexture);
-	if (fadeTexture) SDL_DestroyTexture(fadeTexture);
+	TexPool_release(pooledMove);
+	TexPool_release(pooledFade);
 }
 
 void PLAT_setEffect(int next_type) {
@@ -1712,6 +1753,19 @@ void PLAT_GL_Swap() {
 
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 
+	int transitioning = transition.type != TRANSITION_NONE && transition.progress < 1.0f && g_shader_transition;
+	SDL_Rect final_rect = dst_rect;
+	if (transitioning && transition.type == TRANSITION_ZOOM_FADE) {
+		float eased = transition.progress * transition.progress * (3.0f - 2.0f * transition.progress);
+		float zoom = 6.0f - eased * 5.0f;
+		final_rect.w = dst_rect.w * zoom;
+		final_rect.h = dst_rect.h * zoom;
+		final_rect.x = dst_rect.x + (dst_rect.w - final_rect.w) / 2;
+		final_rect.y = dst_rect.y + (dst_rect.h - final_rect.h) / 2;
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h);
+	}
+
     static GLuint effect_tex = 0;
     static int effect_w = 0, effect_h = 0;
     static GLuint overlay_tex = 0;
@@ -1788,8 +1842,8 @@ void PLAT_GL_Swap() {
     }
 
     if (nrofshaders < 1) {
-        runShaderPass(src_texture, g_shader_default, NULL, dst_rect.x, dst_rect.y,
-            dst_rect.w, dst_rect.h,
+        runShaderPass(src_texture, g_shader_default, NULL, final_rect.x, final_rect.y,
+            final_rect.w, final_rect.h,
             &(Shader){.srcw = vid.blit->src_w, .srch = vid.blit->src_h, .texw = vid.blit->src_w, .texh = vid.blit->src_h},
             0, GL_NONE);
     }
@@ -1868,12 +1922,14 @@ void PLAT_GL_Swap() {
             shaders[nrofshaders - 1]->texture,
             g_shader_default,
             NULL,
-            dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h,
+            final_rect.x, final_rect.y, final_rect.w, final_rect.h,
             &(Shader){.srcw = last_w, .srch = last_h, .texw = last_w, .texh = last_h},
             0, GL_NONE
         );
     }
 
+    if (transitioning && transition.type == TRANSITION_ZOOM_FADE) glDisable(GL_SCISSOR_TEST);
+
     if (effect_tex) {
         runShaderPass(
             effect_tex,
@@ -1896,6 +1952,14 @@ void PLAT_GL_Swap() {
         );
     }
 
+    if (transitioning) {
+		glUseProgram(g_shader_transition);
+		glUniform1f(transition.u_Progress, transition.progress);
+		glUniform1i(transition.u_Mode, transition.type == TRANSITION_CIRCLE);
+		runShaderPass(0, g_shader_transition, NULL, 0, 0, device_width, device_height,
+			&transition.shader, 1, GL_NONE);
+    }
+
     SDL_GL_SwapWindow(vid.window);
     frame_count++;
     reloadShaderTextures = 0;
@@ -1929,6 +1993,15 @@ void PLAT_pixelFlipper(uint8_t* pixels, int width, int height) {
     }
 }
 
+void PLAT_GL_setCurrent(int current) {
+	SDL_GL_MakeCurrent(vid.window, current ? vid.gl_context : NULL);
+}
+
+void PLAT_GL_setTransition(int type, float progress) {
+	transition.type = type;
+	transition.progress = progress;
+}
+
 unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight) {
     glViewport(0, 0, device_width, device_height);
     GLint viewport[4];
@@ -14,6 +14,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <time.h>
 
 // #include "defines.h"
 
@@ -40,6 +45,21 @@
 #define REPEAT		2
 
 #define MUTE_STATE_PATH "/sys/class/gpio/gpio243/value"
+#define MUTE_EDGE_PATH "/sys/class/gpio/gpio243/edge"
+#define MOTOR_VOLTAGE_PATH "/sys/class/motor/voltage"
+#define MOTOR_PATH "/sys/class/gpio/gpio227/value"
+#define STATS_PATH "/tmp/keymon.stats"
+
+#define REPEAT_DELAY_MS		300
+#define REPEAT_INTERVAL_MS	100
+
+#define HAPTIC_STEP_MS		100
+#define HAPTIC_STEPS		4 // on, off, on, off
+
+// sysfs telemetry published through msettings for everyone else: the
+// battery on power_supply uevents, the temperature at whatever interval
+// its readers ask for and not at all while nobody does
+#define TEMP_MIN_INTERVAL_MS	250
 
 #define INPUT_COUNT 5
 static int inputs[INPUT_COUNT] = {};
@@ -48,6 +68,19 @@ static struct input_event ev;
 static volatile int quit = 0;
 static void on_term(int sig) { quit = 1; }
 
+// SIGCONT arrives when we're resumed after sleep (PWR_enterSleep stops us),
+// anything queued up while stopped gets dropped.
+static volatile int resumed = 0;
+static void on_cont(int sig) { resumed = 1; }
+
+// `killall -USR1 keymon.elf` dumps the wakeup counter to STATS_PATH
+static volatile int dump_stats = 0;
+static void on_usr1(int sig) { dump_stats = 1; }
+
+// GetTelemetryTemp() sends USR2 when a reader shows up and we aren't sampling
+static volatile int temp_poked = 0;
+static void on_usr2(int sig) { temp_poked = 1; }
+
 static int getInt(char* path) {
 	int i = 0;
 	FILE *file = fopen(path, "r");
@@ -58,6 +91,45 @@ static int getInt(char* path) {
 	return i;
 }
 
+// the mute buzz is stepped by a timerfd in the event loop instead of
+// sleeping between motor writes, which held up every other key for 300ms.
+// the motor files stay open, a restart from the fallback mute thread only
+// flags it and rearms the timer, all motor writes happen in the loop
+static int haptic_timer = -1;
+static int motor_voltage_fd = -1;
+static int motor_fd = -1;
+static volatile int haptic_restart = 0;
+static int haptic_step = 0;
+
+static void startHaptic(void) {
+	if (haptic_timer<0) return;
+	haptic_restart = 1;
+	struct itimerspec its = {0};
+	its.it_value.tv_nsec = 1; // first step right away
+	its.it_interval.tv_nsec = HAPTIC_STEP_MS * 1000000L;
+	timerfd_settime(haptic_timer, 0, &its, NULL);
+}
+static void stepHaptic(uint64_t expirations) {
+	if (haptic_restart) {
+		haptic_restart = 0;
+		haptic_step = 0;
+		if (motor_voltage_fd>=0) pwrite(motor_voltage_fd, "1500000", 7, 0);
+	}
+	haptic_step += expirations;
+	int on = haptic_step<HAPTIC_STEPS && haptic_step%2;
+	if (motor_fd>=0) pwrite(motor_fd, on ? "1" : "0", 1, 0);
+	if (haptic_step>=HAPTIC_STEPS) {
+		struct itimerspec its = {0};
+		timerfd_settime(haptic_timer, 0, &its, NULL);
+	}
+}
+
+static void onMuteChanged(int is_muted) {
+	SetMute(is_muted);
+	if (GetMute()) startHaptic();
+}
+
+// fallback for kernels where the mute gpio can't raise edge interrupts
 static pthread_t mute_pt;
 static void* watchMute(void *arg) {
 	int is_muted,was_muted;
@@ -72,69 +144,323 @@ static void* watchMute(void *arg) {
 		// swallow mute val -1 on shutdown
 		if (is_muted >= 0 && was_muted!=is_muted) {
 			was_muted = is_muted;
-			SetMute(is_muted);
-			if (GetMute()) {
-				// tmp solution
-				system("echo 1500000 > /sys/class/motor/voltage");
-				system("echo 1 > /sys/class/gpio/gpio227/value");
-				usleep(100000);
-				system("echo 0 > /sys/class/gpio/gpio227/value");
-				usleep(100000);
-				system("echo 1 > /sys/class/gpio/gpio227/value");
-				usleep(100000);
-				system("echo 0 > /sys/class/gpio/gpio227/value");
-			}
+			onMuteChanged(is_muted);
 		}
 	}
 	
 	return NULL;
 }
 
+static int readMuteFd(int fd) {
+	char buf[8] = {0};
+	lseek(fd, 0, SEEK_SET);
+	if (read(fd, buf, sizeof(buf)-1)<=0) return -1;
+	return atoi(buf);
+}
+
+// returns an fd that raises EPOLLPRI when the mute switch flips, or -1
+static int openMuteEdge(void) {
+	int edge = open(MUTE_EDGE_PATH, O_WRONLY | O_CLOEXEC);
+	if (edge<0) return -1;
+	int ok = write(edge, "both", 4)==4;
+	close(edge);
+	if (!ok) return -1;
+	return open(MUTE_STATE_PATH, O_RDONLY | O_CLOEXEC);
+}
+
+static void armRepeat(int fd, int on) {
+	struct itimerspec its = {0};
+	if (on) {
+		its.it_value.tv_nsec = REPEAT_DELAY_MS * 1000000L;
+		its.it_interval.tv_nsec = REPEAT_INTERVAL_MS * 1000000L;
+	}
+	timerfd_settime(fd, 0, &its, NULL);
+}
+
+static void stepSetting(int dir, int menu_pressed, int menu2_pressed) {
+	int val;
+	if (menu_pressed) {
+		val = GetBrightness();
+		if (dir>0 && val<BRIGHTNESS_MAX) SetBrightness(++val);
+		else if (dir<0 && val>BRIGHTNESS_MIN) SetBrightness(--val);
+	}
+	else if (menu2_pressed) {
+		val = GetColortemp();
+		if (dir>0 && val<COLORTEMP_MAX) SetColortemp(++val);
+		else if (dir<0 && val>COLORTEMP_MIN) SetColortemp(--val);
+	}
+	else {
+		val = GetVolume();
+		if (dir>0 && val<VOLUME_MAX) SetVolume(++val);
+		else if (dir<0 && val>VOLUME_MIN) SetVolume(--val);
+	}
+}
+
+enum {
+	SYSFS_CAPACITY,
+	SYSFS_TIME_TO_FULL,
+	SYSFS_CHARGER_ONLINE,
+	SYSFS_CPU_TEMP,
+	SYSFS_COUNT,
+};
+static const char* sysfs_paths[SYSFS_COUNT] = {
+	[SYSFS_CAPACITY]		= "/sys/class/power_supply/axp2202-battery/capacity",
+	[SYSFS_TIME_TO_FULL]	= "/sys/class/power_supply/axp2202-battery/time_to_full_now",
+	[SYSFS_CHARGER_ONLINE]	= "/sys/class/power_supply/axp2202-usb/online",
+	[SYSFS_CPU_TEMP]		= "/sys/devices/virtual/thermal/thermal_zone0/temp",
+};
+static int sysfs_fds[SYSFS_COUNT];
+
+// sysfs attributes regenerate on every read from offset 0,
+// so the fds stay open and pread skips the open/seek/close
+static int readSysfsInt(int id) {
+	char buf[16];
+	if (sysfs_fds[id]<0) return 0;
+	ssize_t len = pread(sysfs_fds[id], buf, sizeof(buf)-1, 0);
+	if (len<=0) return 0;
+	buf[len] = '\0';
+	return atoi(buf);
+}
+
+static unsigned int monotonicMs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void sampleBattery(Telemetry* sample) {
+	sample->charge = readSysfsInt(SYSFS_CAPACITY);
+	sample->charger_online = readSysfsInt(SYSFS_CHARGER_ONLINE);
+	sample->is_charging = sample->charger_online==1 && readSysfsInt(SYSFS_TIME_TO_FULL)>0;
+}
+static void sampleTemp(Telemetry* sample) {
+	sample->cpu_temp = readSysfsInt(SYSFS_CPU_TEMP);
+	sample->temp_updated_ms = monotonicMs();
+}
+
+// follows the readers' requested interval, disarmed while there are none
+static unsigned int temp_interval_ms = 0;
+static void updateTempTimer(int fd) {
+	unsigned int interval = TelemetryTempInterval();
+	if (interval && interval<TEMP_MIN_INTERVAL_MS) interval = TEMP_MIN_INTERVAL_MS;
+	if (interval==temp_interval_ms) return;
+	temp_interval_ms = interval;
+
+	struct itimerspec its = {0};
+	if (interval) {
+		its.it_value.tv_sec = interval / 1000;
+		its.it_value.tv_nsec = (interval % 1000) * 1000000L;
+		its.it_interval = its.it_value;
+	}
+	timerfd_settime(fd, 0, &its, NULL);
+}
+
+// the battery driver raises a power_supply uevent on plug/unplug and
+// level changes, by the time it arrives sysfs already has the new state
+static int openUevents(void) {
+	int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+	if (fd<0) return -1;
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1, // kernel broadcast group
+	};
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr))<0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// drains the socket, returns 1 if any event was about a power supply
+static int readPowerUevents(int fd) {
+	char buf[2048];
+	int power = 0;
+	ssize_t len;
+	while ((len = recv(fd, buf, sizeof(buf)-1, 0))>0) {
+		buf[len] = '\0';
+		// NUL separated KEY=value pairs after the header
+		for (char* line=buf; line<buf+len; line+=strlen(line)+1) {
+			if (!strcmp(line, "SUBSYSTEM=power_supply")) power = 1;
+		}
+	}
+	return power;
+}
+
+static void drainInputs(void) {
+	for (int i=0; i<INPUT_COUNT; i++) {
+		if (inputs[i]<0) continue;
+		while(read(inputs[i], &ev, sizeof(ev))==sizeof(ev));
+	}
+}
+
+static void writeStats(unsigned long long wakeups) {
+	FILE* file = fopen(STATS_PATH, "w");
+	if (!file) return;
+	fprintf(file, "wakeups: %llu\n", wakeups);
+	fclose(file);
+}
+
 int main (int argc, char *argv[]) {
 	struct sigaction sa = {0};
 	sa.sa_handler = on_term;
 	sigaction(SIGTERM, &sa, NULL);
+	sa.sa_handler = on_cont;
+	sigaction(SIGCONT, &sa, NULL);
+	sa.sa_handler = on_usr1;
+	sigaction(SIGUSR1, &sa, NULL);
+	sa.sa_handler = on_usr2;
+	sigaction(SIGUSR2, &sa, NULL);
 
 	InitSettings();
-	pthread_create(&mute_pt, NULL, &watchMute, NULL);
+
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event event = {0};
 
 	char path[32];
 	for (int i=0; i<INPUT_COUNT; i++) {
 		sprintf(path, "/dev/input/event%i", i);
 		inputs[i] = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (inputs[i]<0) continue;
+		event.events = EPOLLIN;
+		event.data.fd = inputs[i];
+		epoll_ctl(epfd, EPOLL_CTL_ADD, inputs[i], &event);
+	}
+
+	int up_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	int down_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	event.events = EPOLLIN;
+	event.data.fd = up_timer;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, up_timer, &event);
+	event.data.fd = down_timer;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, down_timer, &event);
+
+	for (int i=0; i<SYSFS_COUNT; i++)
+		sysfs_fds[i] = open(sysfs_paths[i], O_RDONLY | O_CLOEXEC);
+
+	int uevent_fd = openUevents();
+	if (uevent_fd>=0) {
+		event.data.fd = uevent_fd;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, uevent_fd, &event);
+	}
+
+	Telemetry telemetry = {0};
+	telemetry.publisher = getpid();
+	telemetry.has_battery = uevent_fd>=0; // without uevents readers go to sysfs themselves
+	sampleBattery(&telemetry);
+	PublishTelemetry(&telemetry);
+
+	int temp_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	event.data.fd = temp_timer;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, temp_timer, &event);
+	updateTempTimer(temp_timer); // picks up a reader from before a restart
+
+	motor_voltage_fd = open(MOTOR_VOLTAGE_PATH, O_WRONLY | O_CLOEXEC);
+	motor_fd = open(MOTOR_PATH, O_WRONLY | O_CLOEXEC);
+	haptic_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	event.events = EPOLLIN;
+	event.data.fd = haptic_timer;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, haptic_timer, &event);
+
+	int was_muted = -1;
+	int mute_fd = openMuteEdge();
+	if (mute_fd>=0) {
+		was_muted = readMuteFd(mute_fd);
+		SetMute(was_muted);
+		event.events = EPOLLPRI | EPOLLERR;
+		event.data.fd = mute_fd;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, mute_fd, &event);
+	}
+	else {
+		pthread_create(&mute_pt, NULL, &watchMute, NULL);
 	}
 	
-	uint32_t input;
 	uint32_t val;
 	uint32_t menu_pressed = 0;
 	uint32_t menu2_pressed = 0;
-	
 	uint32_t up_pressed = 0;
-	uint32_t up_just_pressed = 0;
-	uint32_t up_repeat_at = 0;
-	
 	uint32_t down_pressed = 0;
-	uint32_t down_just_pressed = 0;
-	uint32_t down_repeat_at = 0;
-	
-	uint8_t ignore;
-	uint32_t then;
-	uint32_t now;
-	struct timeval tod;
-	
-	gettimeofday(&tod, NULL);
-	then = tod.tv_sec * 1000 + tod.tv_usec / 1000; // essential SDL_GetTicks()
-	ignore = 0;
-	
+	unsigned long long wakeups = 0;
+
+	struct epoll_event events[INPUT_COUNT + 6];
 	while (!quit) {
-		gettimeofday(&tod, NULL);
-		now = tod.tv_sec * 1000 + tod.tv_usec / 1000;
-		if (now-then>1000) ignore = 1; // ignore input that arrived during sleep
-		
-		for (int i=0; i<INPUT_COUNT; i++) {
-			input = inputs[i];
-			while(read(input, &ev, sizeof(ev))==sizeof(ev)) {
-				if (ignore) continue;
+		int count = epoll_wait(epfd, events, INPUT_COUNT + 6, -1);
+		wakeups += 1;
+
+		if (temp_poked) {
+			temp_poked = 0;
+			sampleTemp(&telemetry);
+			PublishTelemetry(&telemetry);
+			updateTempTimer(temp_timer);
+		}
+
+		if (dump_stats) {
+			dump_stats = 0;
+			writeStats(wakeups);
+		}
+		if (resumed) {
+			// ignore input that arrived during sleep
+			resumed = 0;
+			drainInputs();
+			menu_pressed = 0;
+			menu2_pressed = 0;
+			up_pressed = 0;
+			down_pressed = 0;
+			armRepeat(up_timer, 0);
+			armRepeat(down_timer, 0);
+			// the battery kept draining while we were stopped
+			sampleBattery(&telemetry);
+			if (temp_interval_ms) sampleTemp(&telemetry);
+			PublishTelemetry(&telemetry);
+			continue;
+		}
+		if (count<0) continue; // EINTR
+
+		for (int e=0; e<count; e++) {
+			int fd = events[e].data.fd;
+			uint64_t expirations;
+
+			if (fd==up_timer || fd==down_timer) {
+				if (read(fd, &expirations, sizeof(expirations))!=sizeof(expirations)) continue;
+				int dir = fd==up_timer ? 1 : -1;
+				if ((dir>0 && !up_pressed) || (dir<0 && !down_pressed)) continue;
+				for (uint64_t n=0; n<expirations; n++) stepSetting(dir, menu_pressed, menu2_pressed);
+				continue;
+			}
+
+			if (fd==uevent_fd) {
+				if (readPowerUevents(fd)) {
+					sampleBattery(&telemetry);
+					PublishTelemetry(&telemetry);
+				}
+				continue;
+			}
+
+			if (fd==temp_timer) {
+				if (read(fd, &expirations, sizeof(expirations))!=sizeof(expirations)) continue;
+				updateTempTimer(temp_timer);
+				if (!temp_interval_ms) continue; // last reader went away
+				sampleTemp(&telemetry);
+				PublishTelemetry(&telemetry);
+				continue;
+			}
+
+			if (fd==haptic_timer) {
+				if (read(fd, &expirations, sizeof(expirations))!=sizeof(expirations)) continue;
+				stepHaptic(expirations);
+				continue;
+			}
+
+			if (fd==mute_fd) {
+				int is_muted = readMuteFd(mute_fd);
+				// swallow mute val -1 on shutdown
+				if (is_muted >= 0 && was_muted!=is_muted) {
+					was_muted = is_muted;
+					onMuteChanged(is_muted);
+				}
+				continue;
+			}
+
+			while(read(fd, &ev, sizeof(ev))==sizeof(ev)) {
 				val = ev.value;
 				if (ev.type==EV_SW) {
 					//printf("switch: %i\n", ev.code);
@@ -153,77 +479,43 @@ int main (int argc, char *argv[]) {
 						menu2_pressed = val;
 					break;
 					case CODE_PLUS:
-						up_pressed = up_just_pressed = val;
-						if (val) up_repeat_at = now + 300;
+						if (val==REPEAT) break; // timerfd drives repeat
+						up_pressed = val;
+						if (val) stepSetting(1, menu_pressed, menu2_pressed);
+						armRepeat(up_timer, val);
 					break;
 					case CODE_MINUS:
-						down_pressed = down_just_pressed = val;
-						if (val) down_repeat_at = now + 300;
+						if (val==REPEAT) break;
+						down_pressed = val;
+						if (val) stepSetting(-1, menu_pressed, menu2_pressed);
+						armRepeat(down_timer, val);
 					break;
 					default:
 					break;
 				}
 			}
 		}
-		
-		if (ignore) {
-			menu_pressed = 0;
-			menu2_pressed = 0;
-			up_pressed = up_just_pressed = 0;
-			down_pressed = down_just_pressed = 0;
-			up_repeat_at = 0;
-			down_repeat_at = 0;
-		}
-		
-		if (up_just_pressed || (up_pressed && now>=up_repeat_at)) {
-			if (menu_pressed) {
-				val = GetBrightness();
-				if (val<BRIGHTNESS_MAX) SetBrightness(++val);
-			}
-			else if (menu2_pressed) {
-				val = GetColortemp();
-				if (val<COLORTEMP_MAX) {
-					SetColortemp(++val);
-				}
-			}
-			else {
-				val = GetVolume();
-				if (val<VOLUME_MAX) SetVolume(++val);
-			}
-			
-			if (up_just_pressed) up_just_pressed = 0;
-			else up_repeat_at += 100;
-		}
-		
-		if (down_just_pressed || (down_pressed && now>=down_repeat_at)) {
-			if (menu_pressed) {
-				val = GetBrightness();
-				if (val>BRIGHTNESS_MIN) SetBrightness(--val);
-			}
-			else if (menu2_pressed) {
-				val = GetColortemp();
-				if (val>COLORTEMP_MIN) {
-					SetColortemp(--val);
-				}
-			}
-			else {
-				val = GetVolume();
-				if (val>VOLUME_MIN) SetVolume(--val);
-			}
-			
-			if (down_just_pressed) down_just_pressed = 0;
-			else down_repeat_at += 100;
-		}
-		
-		then = now;
-		ignore = 0;
-		
-		usleep(16666); // 60fps
 	}
 
 	for (int i=0; i<INPUT_COUNT; i++)
-		close(inputs[i]);
+		if (inputs[i]>=0) close(inputs[i]);
+	close(up_timer);
+	close(down_timer);
+	close(temp_timer);
+	if (uevent_fd>=0) close(uevent_fd);
+	close(epfd);
+	for (int i=0; i<SYSFS_COUNT; i++)
+		if (sysfs_fds[i]>=0) close(sysfs_fds[i]);
 	
-	pthread_cancel(mute_pt);
-	pthread_join(mute_pt, NULL);
+	if (mute_fd>=0) close(mute_fd);
+	else {
+		pthread_cancel(mute_pt);
+		pthread_join(mute_pt, NULL);
+	}
+	if (motor_fd>=0) {
+		pwrite(motor_fd, "0", 1, 0); // don't leave it buzzing
+		close(motor_fd);
+	}
+	if (motor_voltage_fd>=0) close(motor_voltage_fd);
+	close(haptic_timer);
 }
@@ -10,7 +10,16 @@
 #include <sys/stat.h>
 #include <dlfcn.h>
 #include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
 #include <tinyalsa/mixer.h>
+#include <alsa/asoundlib.h>
 
 #include "msettings.h"
 
@@ -213,6 +222,16 @@ static int shm_fd = -1;
 static int is_host = 0;
 static int shm_size = sizeof(Settings);
 
+// lives in the shm right after Settings and is never saved. Setters
+// bump the sequence around every change (odd while writing) so readers
+// can tell something changed and copy several fields without tearing.
+typedef struct SettingsSync {
+	unsigned int sequence;
+	unsigned int waiters;
+} SettingsSync;
+static SettingsSync* settings_sync;
+static int map_size = sizeof(Settings) + sizeof(SettingsSync);
+
 int scaleBrightness(int);
 int scaleColortemp(int);
 int scaleContrast(int);
@@ -220,6 +239,8 @@ int scaleSaturation(int);
 int scaleExposure(int);
 int scaleVolume(int);
 
+static void closeMixers(void);
+
 void disableDpad(int);
 void emulateJoystick(int);
 void turboA(int);
@@ -285,14 +306,16 @@ void InitSettings(void) {
 	if (shm_fd==-1 && errno==EEXIST) { // already exists
 		// puts("Settings client");
 		shm_fd = shm_open(SHM_KEY, O_RDWR, 0644);
-		settings = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+		settings = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+		settings_sync = (SettingsSync*)(settings + 1);
 	}
 	else { // host
 		// puts("Settings host"); // keymon
 		is_host = 1;
 		// we created it so set initial size and populate
-		ftruncate(shm_fd, shm_size);
-		settings = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+		ftruncate(shm_fd, map_size);
+		settings = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+		settings_sync = (SettingsSync*)(settings + 1);
 
 		// peek the first int from fd, it's the version
 		int version = peekVersion(SettingsPath);
@@ -485,7 +508,8 @@ int InitializedSettings(void) {
 	return (settings != NULL);
 }
 void QuitSettings(void) {
-	munmap(settings, shm_size);
+	closeMixers();
+	munmap(settings, map_size);
 	if (is_host) shm_unlink(SHM_KEY);
 }
 static inline void SaveSettings(void) {
@@ -497,6 +521,67 @@ static inline void SaveSettings(void) {
 	}
 }
 
+///////// Change tracking
+
+#define SETTINGS_WRITE_SPINS 1000
+#define SETTINGS_READ_RETRIES 64
+
+// setters run in keymon, audiomon and the frontends, so the odd
+// sequence doubles as a lock between them. Returns 0 when the current
+// holder looks stuck (stopped mid-write) and we went ahead anyway.
+static int beginSettingsWrite(void) {
+	for (int i=0; i<SETTINGS_WRITE_SPINS; i++) {
+		unsigned int seq = __atomic_load_n(&settings_sync->sequence, __ATOMIC_RELAXED);
+		if (!(seq & 1) && __atomic_compare_exchange_n(&settings_sync->sequence, &seq, seq + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return 1;
+		sched_yield();
+	}
+	return 0;
+}
+static void endSettingsWrite(int locked) {
+	// without the lock keep the parity the stuck writer expects
+	__atomic_fetch_add(&settings_sync->sequence, locked ? 1 : 2, __ATOMIC_RELEASE);
+	if (__atomic_load_n(&settings_sync->waiters, __ATOMIC_ACQUIRE))
+		syscall(SYS_futex, &settings_sync->sequence, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+#define WRITE_SETTING(field, value) do { \
+	int locked = beginSettingsWrite(); \
+	settings->field = (value); \
+	endSettingsWrite(locked); \
+} while (0)
+
+// consistent copy for getters that combine several fields
+static void readSettings(Settings* copy) {
+	for (int i=0; i<SETTINGS_READ_RETRIES; i++) {
+		unsigned int seq = __atomic_load_n(&settings_sync->sequence, __ATOMIC_ACQUIRE);
+		if (seq & 1) continue;
+		memcpy(copy, settings, sizeof(Settings));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&settings_sync->sequence, __ATOMIC_RELAXED)==seq) return;
+	}
+	memcpy(copy, settings, sizeof(Settings)); // writer is stuck, best effort
+}
+
+unsigned int GetSettingsGeneration(void) {
+	return __atomic_load_n(&settings_sync->sequence, __ATOMIC_ACQUIRE) >> 1;
+}
+
+int WaitSettingsChange(unsigned int generation, int timeout_ms) {
+	unsigned int seq = __atomic_load_n(&settings_sync->sequence, __ATOMIC_ACQUIRE);
+	if ((seq >> 1)!=generation) return 1;
+
+	struct timespec timeout = {
+		.tv_sec = timeout_ms / 1000,
+		.tv_nsec = (timeout_ms % 1000) * 1000000L,
+	};
+	__atomic_fetch_add(&settings_sync->waiters, 1, __ATOMIC_ACQ_REL);
+	// the shm is MAP_SHARED across processes, so no FUTEX_PRIVATE_FLAG
+	syscall(SYS_futex, &settings_sync->sequence, FUTEX_WAIT, seq, timeout_ms < 0 ? NULL : &timeout, NULL, 0);
+	__atomic_fetch_sub(&settings_sync->waiters, 1, __ATOMIC_ACQ_REL);
+
+	return GetSettingsGeneration()!=generation;
+}
+
 ///////// Getters exposed in public API
 
 int GetBrightness(void) { // 0-10
@@ -506,13 +591,16 @@ int GetColortemp(void) { // 0-10
 	return settings->colortemperature;
 }
 int GetVolume(void) { // 0-20
-	if (settings->mute && GetMutedVolume() != SETTINGS_DEFAULT_MUTE_NO_CHANGE)
-		return GetMutedVolume();
+	Settings current;
+	readSettings(&current);
+
+	if (current.mute && current.toggled_volume != SETTINGS_DEFAULT_MUTE_NO_CHANGE)
+		return current.toggled_volume;
 	
-	if(settings->jack || settings->audiosink != AUDIO_SINK_DEFAULT)
-		return settings->headphones;
+	if(current.jack || current.audiosink != AUDIO_SINK_DEFAULT)
+		return current.headphones;
 
-	return settings->speaker;
+	return current.speaker;
 }
 // monitored and set by thread in keymon
 int GetJack(void) {
@@ -611,12 +699,12 @@ int GetMuteTurboR2(void)
 
 void SetBrightness(int value) {
 	SetRawBrightness(scaleBrightness(value));
-	settings->brightness = value;
+	WRITE_SETTING(brightness, value);
 	SaveSettings();
 }
 void SetColortemp(int value) {
 	SetRawColortemp(scaleColortemp(value));
-	settings->colortemperature = value;
+	WRITE_SETTING(colortemperature, value);
 	SaveSettings();
 }
 void SetVolume(int value) { // 0-20
@@ -624,9 +712,9 @@ void SetVolume(int value) { // 0-20
 		return SetRawVolume(scaleVolume(GetMutedVolume()));
 	
 	if (settings->jack || settings->audiosink != AUDIO_SINK_DEFAULT)
-		settings->headphones = value;
+		WRITE_SETTING(headphones, value);
 	else
-		settings->speaker = value;
+		WRITE_SETTING(speaker, value);
 
 	SetRawVolume(scaleVolume(value));
 	SaveSettings();
@@ -635,21 +723,21 @@ void SetVolume(int value) { // 0-20
 void SetJack(int value) {
 	printf("SetJack(%i)\n", value); fflush(stdout);
 	
-	settings->jack = value;
+	WRITE_SETTING(jack, value);
 	SetVolume(GetVolume());
 }
 // monitored and set by thread in audiomon
 void SetAudioSink(int value) {
 	printf("SetAudioSink(%i)\n", value); fflush(stdout);
 	
-	settings->audiosink = value;
+	WRITE_SETTING(audiosink, value);
 	SetVolume(GetVolume());
 }
 
 void SetHDMI(int value){};
 
 void SetMute(int value) {
-	settings->mute = value;
+	WRITE_SETTING(mute, value);
 	if (settings->mute) {
 		if (GetMutedVolume() != SETTINGS_DEFAULT_MUTE_NO_CHANGE)
 			SetRawVolume(scaleVolume(GetMutedVolume()));
@@ -719,114 +807,114 @@ void SetMute(int value) {
 void SetContrast(int value)
 {
 	SetRawContrast(scaleContrast(value));
-	settings->contrast = value;
+	WRITE_SETTING(contrast, value);
 	SaveSettings();
 }
 void SetSaturation(int value)
 {
 	SetRawSaturation(scaleSaturation(value));
-	settings->saturation = value;
+	WRITE_SETTING(saturation, value);
 	SaveSettings();
 }
 void SetExposure(int value)
 {
 	SetRawExposure(scaleExposure(value));
-	settings->exposure = value;
+	WRITE_SETTING(exposure, value);
 	SaveSettings();
 }
 
 void SetMutedBrightness(int value)
 {
-	settings->toggled_brightness = value;
+	WRITE_SETTING(toggled_brightness, value);
 	SaveSettings();
 }
 
 void SetMutedColortemp(int value)
 {
-	settings->toggled_colortemperature = value;
+	WRITE_SETTING(toggled_colortemperature, value);
 	SaveSettings();
 }
 
 void SetMutedContrast(int value)
 {
-	settings->toggled_contrast = value;
+	WRITE_SETTING(toggled_contrast, value);
 	SaveSettings();
 }
 
 void SetMutedSaturation(int value)
 {
-	settings->toggled_saturation = value;
+	WRITE_SETTING(toggled_saturation, value);
 	SaveSettings();
 }
 
 void SetMutedExposure(int value)
 {
-	settings->toggled_exposure = value;
+	WRITE_SETTING(toggled_exposure, value);
 	SaveSettings();
 }
 
 void SetMutedVolume(int value)
 {
-	settings->toggled_volume = value;
+	WRITE_SETTING(toggled_volume, value);
 	SaveSettings();
 }
 
 void SetMuteDisablesDpad(int value)
 {
-	settings->disable_dpad_on_mute = value;
+	WRITE_SETTING(disable_dpad_on_mute, value);
 	SaveSettings();
 }
 void SetMuteEmulatesJoystick(int value)
 {
-	settings->emulate_joystick_on_mute = value;
+	WRITE_SETTING(emulate_joystick_on_mute, value);
 	SaveSettings();
 }
 
 void SetMuteTurboA(int value)
 {
-	settings->turbo_a = value;
+	WRITE_SETTING(turbo_a, value);
 	SaveSettings();
 }
 
 void SetMuteTurboB(int value)
 {
-	settings->turbo_b = value;
+	WRITE_SETTING(turbo_b, value);
 	SaveSettings();
 }
 
 void SetMuteTurboX(int value)
 {
-	settings->turbo_x = value;
+	WRITE_SETTING(turbo_x, value);
 	SaveSettings();
 }
 
 void SetMuteTurboY(int value)
 {
-	settings->turbo_y = value;
+	WRITE_SETTING(turbo_y, value);
 	SaveSettings();
 }
 
 void SetMuteTurboL1(int value)
 {
-	settings->turbo_l1 = value;
+	WRITE_SETTING(turbo_l1, value);
 	SaveSettings();
 }
 
 void SetMuteTurboL2(int value)
 {
-	settings->turbo_l2 = value;
+	WRITE_SETTING(turbo_l2, value);
 	SaveSettings();
 }
 
 void SetMuteTurboR1(int value)
 {
-	settings->turbo_r1 = value;
+	WRITE_SETTING(turbo_r1, value);
 	SaveSettings();
 }
 
 void SetMuteTurboR2(int value)
 {
-	settings->turbo_r2 = value;
+	WRITE_SETTING(turbo_r2, value);
 	SaveSettings();
 }
 
@@ -1103,45 +1191,152 @@ void SetRawColortemp(int val) { // 0 - 255
 	}
 }
 
-// Find the first A2DP playback volume control via amixer
-static int get_a2dp_simple_control_name(char *buf, size_t buflen) {
-    FILE *fp = popen("amixer scontrols", "r");
-    if (!fp) return 0;
-
-    char line[256];
-    while (fgets(line, sizeof(line), fp)) {
-        char *start = strchr(line, '\'');
-        char *end = strrchr(line, '\'');
-        if (start && end && end > start) {
-            size_t len = end - start - 1;
-            if (len < buflen) {
-                strncpy(buf, start + 1, len);
-                buf[len] = '\0';
-                if (strstr(buf, "A2DP")) { // first A2DP simple control
-                    pclose(fp);
-					char esc_buf[128];
-					char *src = buf;
-					char *dst = esc_buf;
-					while(*src && (dst - esc_buf) < (sizeof(esc_buf) - 4)) {
-						if(*src == '\"') {
-							*dst++ = '\\';
-							*dst++ = '\"';
-						} else {
-							*dst++ = *src;
-						}
-						src++;
-					}
-					*dst = '\0';
-					strncpy(buf, esc_buf, buflen);
-					buf[buflen - 1] = '\0';
-					return 1;
-                }
-            }
-        }
-    }
+///////// Mixer
+
+// keymon fires a volume step every 100ms while the key is held, so the
+// mixer handles stay open between calls instead of being reopened (or
+// shelled out to amixer) for every step. A handle that stops working,
+// e.g. the usb dac or the headset went away, is dropped and reopened.
+
+#define MIXER_CARDS 2 // 0: internal codec, 1: usb dac
+static struct mixer* card_mixers[MIXER_CARDS];
+
+static struct mixer* getCardMixer(unsigned int card) {
+	if (!card_mixers[card]) card_mixers[card] = mixer_open(card);
+	return card_mixers[card];
+}
+static void dropCardMixer(unsigned int card) {
+	if (!card_mixers[card]) return;
+	mixer_close(card_mixers[card]);
+	card_mixers[card] = NULL;
+}
+
+// bluealsa is an alsa-lib ctl plugin, tinyalsa can't see it
+static snd_mixer_t* a2dp_mixer;
 
-    pclose(fp);
-    return 0;
+static void dropA2dpMixer(void) {
+	if (!a2dp_mixer) return;
+	snd_mixer_close(a2dp_mixer);
+	a2dp_mixer = NULL;
+}
+static snd_mixer_t* getA2dpMixer(void) {
+	if (a2dp_mixer) return a2dp_mixer;
+
+	snd_mixer_t* mixer;
+	if (snd_mixer_open(&mixer, 0) < 0) return NULL;
+	snd_hctl_t* hctl;
+	if (snd_mixer_attach(mixer, "default") < 0
+		|| snd_mixer_get_hctl(mixer, "default", &hctl) < 0
+		|| snd_hctl_nonblock(hctl, 1) < 0 // handling events must never wait on the ctl
+		|| snd_mixer_selem_register(mixer, NULL, NULL) < 0
+		|| snd_mixer_load(mixer) < 0) {
+		snd_mixer_close(mixer);
+		return NULL;
+	}
+	a2dp_mixer = mixer;
+	return a2dp_mixer;
+}
+
+// first A2DP playback control, what `amixer scontrols` used to find;
+// the element list lives in memory, this costs one poll() at most
+static snd_mixer_elem_t* findA2dpControl(snd_mixer_t* mixer) {
+	// picks up controls added or removed since the last call, only
+	// reading the ctl when it has something pending
+	struct pollfd fds[4];
+	int count = snd_mixer_poll_descriptors(mixer, fds, 4);
+	unsigned short revents = 0;
+	if (count > 0 && poll(fds, count, 0) > 0
+		&& snd_mixer_poll_descriptors_revents(mixer, fds, count, &revents) >= 0
+		&& (revents & POLLIN)) {
+		snd_mixer_handle_events(mixer);
+	}
+	for (snd_mixer_elem_t* elem = snd_mixer_first_elem(mixer); elem; elem = snd_mixer_elem_next(elem)) {
+		if (!snd_mixer_selem_is_active(elem) || !snd_mixer_selem_has_playback_volume(elem)) continue;
+		if (strstr(snd_mixer_selem_get_name(elem), "A2DP")) return elem;
+	}
+	return NULL;
+}
+
+// same curve as `amixer -M`: linear in dB for wide ranges so the
+// steps sound even, plain linear for controls without dB info
+#define MAX_LINEAR_DB_SCALE 24
+static int setNormalizedVolume(snd_mixer_elem_t* elem, int percent) {
+	double volume = percent / 100.0;
+	long min, max;
+
+	if (snd_mixer_selem_get_playback_dB_range(elem, &min, &max) < 0 || min >= max) {
+		if (snd_mixer_selem_get_playback_volume_range(elem, &min, &max) < 0) return -1;
+		return snd_mixer_selem_set_playback_volume_all(elem, lrint(volume * (max - min)) + min);
+	}
+
+	if (max - min <= MAX_LINEAR_DB_SCALE * 100)
+		return snd_mixer_selem_set_playback_dB_all(elem, lrint(volume * (max - min)) + min, 0);
+
+	if (min != SND_CTL_TLV_DB_GAIN_MUTE) {
+		double min_norm = pow(10, (min - max) / 6000.0);
+		volume = volume * (1 - min_norm) + min_norm;
+	}
+	if (volume <= 0) return snd_mixer_selem_set_playback_dB_all(elem, min, 0);
+	return snd_mixer_selem_set_playback_dB_all(elem, lrint(6000.0 * log10(volume)) + max, 0);
+}
+
+static void setA2dpVolume(int val) {
+	// a headset reconnect can leave a stale control list behind, reopen once
+	for (int attempt=0; attempt<2; attempt++) {
+		snd_mixer_t* mixer = getA2dpMixer();
+		if (!mixer) return;
+		snd_mixer_elem_t* elem = findA2dpControl(mixer);
+		if (elem && setNormalizedVolume(elem, val) >= 0) return;
+		dropA2dpMixer();
+	}
+}
+
+static int setUsbDacVolume(struct mixer* mixer, int val) {
+	const unsigned int num_controls = mixer_get_num_ctls(mixer);
+	for (unsigned int i = 0; i < num_controls; i++) {
+		struct mixer_ctl *ctl = mixer_get_ctl(mixer, i);
+		const char *name = mixer_ctl_get_name(ctl);
+		if (!name) continue;
+
+		if (strstr(name, "PCM") && (strstr(name, "Volume") || strstr(name, "volume"))) {
+			if (mixer_ctl_get_type(ctl) == MIXER_CTL_TYPE_INT) {
+				int min = mixer_ctl_get_range_min(ctl);
+				int max = mixer_ctl_get_range_max(ctl);
+				int volume = min + (val * (max - min)) / 100;
+				unsigned int num_values = mixer_ctl_get_num_values(ctl);
+				for (unsigned int i = 0; i < num_values; i++)
+					if (mixer_ctl_set_value(ctl, i, volume) < 0) return -1;
+			}
+			break;
+		}
+	}
+	return 0;
+}
+
+static int setSpeakerVolume(struct mixer* mixer, int val) {
+	int result = 0;
+	struct mixer_ctl *digital = mixer_get_ctl_by_name(mixer, "digital volume");
+	if (digital) {
+		if (mixer_ctl_set_percent(digital, 0, 100 - val) < 0) result = -1; // reversed mapping
+		//printf("Set 'digital volume' to %d%%\n", val); fflush(stdout);
+	}
+	
+	// Digital volume does not quite go to 0, so also mute the DAC volume
+	struct mixer_ctl *dac     = mixer_get_ctl_by_name(mixer, "DAC volume");
+	if (dac) {
+		int dac_val = (val == 0 ? 0 : 160);
+		unsigned int num_values = mixer_ctl_get_num_values(dac);
+		for (unsigned int i = 0; i < num_values; i++)
+			if (mixer_ctl_set_value(dac, i, dac_val) < 0) result = -1;
+		//printf("Set 'DAC volume' to %d\n", dac_val); fflush(stdout);
+	}
+	return result;
+}
+
+static void closeMixers(void) {
+	for (int card=0; card<MIXER_CARDS; card++)
+		dropCardMixer(card);
+	dropA2dpMixer();
 }
 
 void SetRawVolume(int val) { // in: 0-100
@@ -1150,66 +1345,31 @@ void SetRawVolume(int val) { // in: 0-100
 
     if (GetAudioSink() == AUDIO_SINK_BLUETOOTH) {
         // bluealsa is a mixer plugin, not exposed as a separate card
-        char ctl_name[128] = {0};
-        if (get_a2dp_simple_control_name(ctl_name, sizeof(ctl_name))) {
-			char cmd[256];
-            // Update volume on the device
-            snprintf(cmd, sizeof(cmd), "amixer sset \"%s\" -M %d%% &> /dev/null", ctl_name, val);
-            system(cmd);
-			//printf("Set '%s' to %d%%\n", ctl_name, val); fflush(stdout);
-        }
+		setA2dpVolume(val);
     } 
 	else if (GetAudioSink() == AUDIO_SINK_USBDAC) {
 		// USB DAC path: use card 1
-		struct mixer *mixer = mixer_open(1);
-		if (!mixer) {
-			printf("Failed to open mixer\n"); fflush(stdout);
-			return;
+		for (int attempt=0; attempt<2; attempt++) {
+			struct mixer *mixer = getCardMixer(1);
+			if (!mixer) {
+				printf("Failed to open mixer\n"); fflush(stdout);
+				return;
+			}
+			if (setUsbDacVolume(mixer, val) == 0) break;
+			dropCardMixer(1);
 		}
-
-        const unsigned int num_controls = mixer_get_num_ctls(mixer);
-        for (unsigned int i = 0; i < num_controls; i++) {
-            struct mixer_ctl *ctl = mixer_get_ctl(mixer, i);
-            const char *name = mixer_ctl_get_name(ctl);
-            if (!name) continue;
-
-            if (strstr(name, "PCM") && (strstr(name, "Volume") || strstr(name, "volume"))) {
-                if (mixer_ctl_get_type(ctl) == MIXER_CTL_TYPE_INT) {
-                    int min = mixer_ctl_get_range_min(ctl);
-                    int max = mixer_ctl_get_range_max(ctl);
-                    int volume = min + (val * (max - min)) / 100;
-					unsigned int num_values = mixer_ctl_get_num_values(ctl);
-					for (unsigned int i = 0; i < num_values; i++)
-						mixer_ctl_set_value(ctl, i, volume);
-                }
-                break;
-            }
-        }
 	}
 	else {
         // Speaker path: use direct lookup by name
-		struct mixer *mixer = mixer_open(0);
-        if (!mixer) {
-            printf("Failed to open mixer\n"); fflush(stdout);
-            return;
-        }
-
-        struct mixer_ctl *digital = mixer_get_ctl_by_name(mixer, "digital volume");
-        if (digital) {
-			mixer_ctl_set_percent(digital, 0, 100 - val); // reversed mapping
-			//printf("Set 'digital volume' to %d%%\n", val); fflush(stdout);
-		}
-		
-		// Digital volume does not quite go to 0, so also mute the DAC volume
-		struct mixer_ctl *dac     = mixer_get_ctl_by_name(mixer, "DAC volume");
-        if (dac) {
-            int dac_val = (val == 0 ? 0 : 160);
-            unsigned int num_values = mixer_ctl_get_num_values(dac);
-            for (unsigned int i = 0; i < num_values; i++)
-                mixer_ctl_set_value(dac, i, dac_val);
-			//printf("Set 'DAC volume' to %d\n", dac_val); fflush(stdout);
+		for (int attempt=0; attempt<2; attempt++) {
+			struct mixer *mixer = getCardMixer(0);
+			if (!mixer) {
+				printf("Failed to open mixer\n"); fflush(stdout);
+				return;
+			}
+			if (setSpeakerVolume(mixer, val) == 0) break;
+			dropCardMixer(0);
 		}
-		mixer_close(mixer);
 
 		// Really, actually, finally turn the speaker off - including the hissing
 		putInt("/sys/class/speaker/mute", val == 0 ? 1 : 0);
@@ -1243,3 +1403,135 @@ void SetRawExposure(int val){
 		fclose(fd);
 	}
 }
+
+///////// Telemetry
+
+// keymon samples sysfs into this block, everyone else copies it out
+// under a seqlock instead of opening the sysfs files themselves.
+// samples only change on events, so their age says nothing about keymon
+// still running, readers check its pid instead
+#define TELEMETRY_SHM_KEY "/SharedTelemetry"
+#define TELEMETRY_ALIVE_MS 1000 // how long a pid check is trusted
+#define TELEMETRY_RETRIES 64
+#define TELEMETRY_REMAP_MS 1000
+#define TELEMETRY_TEMP_LINGER 3 // intervals keymon keeps sampling after the last request
+
+static Telemetry* telemetry;
+static unsigned int telemetry_mapped_at;
+static unsigned int telemetry_alive_at;
+static unsigned int telemetry_poked_at;
+
+static unsigned int telemetryNow(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static int mapTelemetry(int publisher) {
+	if (telemetry) return 1;
+
+	// readers retry at most once a second until keymon is up
+	unsigned int now = telemetryNow();
+	if (!publisher && telemetry_mapped_at && now - telemetry_mapped_at < TELEMETRY_REMAP_MS) return 0;
+	telemetry_mapped_at = now;
+
+	// readers write their temperature requests, so everyone maps it writable
+	int fd = shm_open(TELEMETRY_SHM_KEY, publisher ? O_RDWR | O_CREAT : O_RDWR, 0644);
+	if (fd==-1) return 0;
+	if (publisher) ftruncate(fd, sizeof(Telemetry));
+	else {
+		struct stat st;
+		if (fstat(fd, &st)==-1 || st.st_size < sizeof(Telemetry)) {
+			close(fd);
+			return 0;
+		}
+	}
+
+	void* map = mmap(NULL, sizeof(Telemetry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map==MAP_FAILED) return 0;
+
+	telemetry = map;
+	return 1;
+}
+
+static int telemetryAlive(unsigned int now) {
+	if (telemetry_alive_at && now - telemetry_alive_at < TELEMETRY_ALIVE_MS) return 1;
+	int pid = __atomic_load_n(&telemetry->publisher, __ATOMIC_RELAXED);
+	if (pid<=0 || kill(pid, 0)==-1) {
+		telemetry_alive_at = 0;
+		return 0;
+	}
+	telemetry_alive_at = now;
+	return 1;
+}
+
+static int readTelemetry(Telemetry* out) {
+	// a publisher frozen mid-write leaves the sequence odd, give up
+	// after a few tries and let the caller fall back to sysfs
+	for (int i=0; i<TELEMETRY_RETRIES; i++) {
+		unsigned int seq = __atomic_load_n(&telemetry->sequence, __ATOMIC_ACQUIRE);
+		if (seq & 1) continue;
+
+		memcpy(out, (const void*)telemetry, sizeof(Telemetry));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&telemetry->sequence, __ATOMIC_RELAXED)!=seq) continue;
+
+		return seq!=0;
+	}
+	return 0;
+}
+
+int GetTelemetry(Telemetry* out) {
+	if (!mapTelemetry(0)) return 0;
+	if (!telemetryAlive(telemetryNow())) return 0;
+	return readTelemetry(out) && out->has_battery;
+}
+
+int GetTelemetryTemp(unsigned int interval_ms) {
+	if (!mapTelemetry(0)) return -1;
+	unsigned int now = telemetryNow();
+	if (!telemetryAlive(now)) return -1;
+
+	// the last reader's interval wins, there is normally just the one
+	__atomic_store_n(&telemetry->temp_interval_ms, interval_ms, __ATOMIC_RELAXED);
+	__atomic_store_n(&telemetry->temp_wanted_ms, now, __ATOMIC_RELEASE);
+
+	Telemetry sample;
+	if (readTelemetry(&sample) && sample.temp_updated_ms && now - sample.temp_updated_ms <= interval_ms * 2)
+		return sample.cpu_temp;
+
+	// keymon isn't sampling yet or fell behind, wake it at most once an interval
+	if (!telemetry_poked_at || now - telemetry_poked_at >= interval_ms) {
+		telemetry_poked_at = now;
+		kill(__atomic_load_n(&telemetry->publisher, __ATOMIC_RELAXED), SIGUSR2);
+	}
+	return -1;
+}
+
+unsigned int TelemetryTempInterval(void) {
+	if (!mapTelemetry(1)) return 0;
+	unsigned int interval = __atomic_load_n(&telemetry->temp_interval_ms, __ATOMIC_RELAXED);
+	unsigned int wanted = __atomic_load_n(&telemetry->temp_wanted_ms, __ATOMIC_ACQUIRE);
+	if (!interval || !wanted || telemetryNow() - wanted > interval * TELEMETRY_TEMP_LINGER) return 0;
+	return interval;
+}
+
+void PublishTelemetry(const Telemetry* sample) {
+	if (!mapTelemetry(1)) return;
+
+	unsigned int seq = telemetry->sequence;
+	__atomic_store_n(&telemetry->sequence, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	telemetry->updated_ms = telemetryNow();
+	telemetry->publisher = sample->publisher;
+	telemetry->has_battery = sample->has_battery;
+	telemetry->charge = sample->charge;
+	telemetry->is_charging = sample->is_charging;
+	telemetry->charger_online = sample->charger_online;
+	telemetry->cpu_temp = sample->cpu_temp;
+	telemetry->temp_updated_ms = sample->temp_updated_ms;
+
+	__atomic_store_n(&telemetry->sequence, seq + 2, __ATOMIC_RELEASE);
+}
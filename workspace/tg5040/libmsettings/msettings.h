@@ -15,6 +15,12 @@ void InitSettings(void);
 void QuitSettings(void);
 int InitializedSettings(void);
 
+// bumped by every setter in any process, cheap enough to poll each frame
+unsigned int GetSettingsGeneration(void);
+// blocks until the generation moves past the given one or the timeout
+// (-1 waits forever) expires, returns 1 if it changed
+int WaitSettingsChange(unsigned int generation, int timeout_ms);
+
 int GetBrightness(void);
 int GetColortemp(void);
 int GetContrast(void);
@@ -87,4 +93,27 @@ void SetMuteTurboL2(int);
 void SetMuteTurboR1(int);
 void SetMuteTurboR2(int);
 
+// sysfs state sampled by keymon and shared like the settings above.
+// battery fields follow power_supply uevents, the temperature is only
+// sampled while a reader asks for it through GetTelemetryTemp()
+typedef struct Telemetry {
+	unsigned int sequence; // odd while keymon is writing
+	unsigned int updated_ms; // CLOCK_MONOTONIC
+	int publisher; // keymon's pid
+	int has_battery; // 0 without uevents, read sysfs instead
+	int charge; // 0-100
+	int is_charging;
+	int charger_online;
+	int cpu_temp; // millidegrees celsius
+	unsigned int temp_updated_ms;
+	// written by readers, outside the seqlock
+	unsigned int temp_wanted_ms;
+	unsigned int temp_interval_ms;
+} Telemetry;
+
+int GetTelemetry(Telemetry* out); // 0 when keymon isn't publishing the battery
+int GetTelemetryTemp(unsigned int interval_ms); // millidegrees or -1, registers the caller as a reader
+unsigned int TelemetryTempInterval(void); // keymon only, 0 once no reader asked for a while
+void PublishTelemetry(const Telemetry* sample); // keymon only
+
 #endif  // __msettings_h__
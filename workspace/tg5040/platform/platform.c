@@ -22,6 +22,9 @@
 #include "scaler.h"
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include <dirent.h>
 
@@ -60,6 +63,17 @@ GLuint g_shader_default = 0;
 GLuint g_shader_overlay = 0;
 GLuint g_shader_overlay_mul = 0;
 GLuint g_noshader = 0;
+GLuint g_shader_transition = 0;
+
+// startup fades and reveals are a black pass blended over the finished
+// frame, minarch only advances progress so the core's buffer is untouched
+static struct {
+	int type;
+	float progress;
+	GLint u_Progress;
+	GLint u_Mode;
+	Shader shader;
+} transition;
 
 Shader* shaders[MAXSHADERS] = {
     &(Shader){ .shader_p = 0, .scale = 1, .filter = GL_LINEAR, .scaletype = 1, .srctype = 0, .filename ="stock.glsl", .texture = 0, .updated = 1 },
@@ -148,6 +162,52 @@ void PLAT_updateInput(const SDL_Event *event) {
     }
 }
 
+// a second reader on the evdev nodes, only open while latency probing,
+// SDL throws away the kernel timestamp of the events it hands us.
+// linux/input.h would clobber our BTN_* enum so mirror the bits we need
+#include <sys/time.h>
+struct evdev_event {
+	struct timeval time;
+	uint16_t type;
+	uint16_t code;
+	int32_t value;
+};
+#define EVDEV_KEY	0x01
+#define EVDEV_ABS	0x03
+#define EVDEV_HAT0X	0x10
+#define EVDEV_HAT0Y	0x11
+#define INPUT_TS_COUNT 5
+static int input_ts_fds[INPUT_TS_COUNT] = {-1,-1,-1,-1,-1};
+void PLAT_setInputTimestamps(int enable) {
+	char path[32];
+	for (int i=0; i<INPUT_TS_COUNT; i++) {
+		if (enable && input_ts_fds[i]<0) {
+			sprintf(path, "/dev/input/event%i", i);
+			input_ts_fds[i] = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		}
+		else if (!enable && input_ts_fds[i]>=0) {
+			close(input_ts_fds[i]);
+			input_ts_fds[i] = -1;
+		}
+	}
+}
+uint64_t PLAT_getInputTimestamp(void) {
+	// evdev stamps with CLOCK_REALTIME by default, same clock as getMicroseconds()
+	uint64_t newest = 0;
+	struct evdev_event ev;
+	for (int i=0; i<INPUT_TS_COUNT; i++) {
+		if (input_ts_fds[i]<0) continue;
+		while (read(input_ts_fds[i], &ev, sizeof(ev))==sizeof(ev)) {
+			// sticks stream constantly so only keys and the dpad hat count
+			int press = (ev.type==EVDEV_KEY && ev.value==1) || (ev.type==EVDEV_ABS && (ev.code==EVDEV_HAT0X || ev.code==EVDEV_HAT0Y) && ev.value!=0);
+			if (!press) continue;
+			uint64_t at = (uint64_t)ev.time.tv_sec * 1000000 + ev.time.tv_usec;
+			if (at>newest) newest = at;
+		}
+	}
+	return newest;
+}
+
 ///////////////////////////////
 
 static struct VID_Context {
@@ -220,74 +280,149 @@ int extractPragmaParameters(const char *shaderSource, ShaderParam *params, int m
     return paramCount; // number of parameters found
 }
 
-GLuint link_program(GLuint vertex_shader, GLuint fragment_shader, const char* cache_key) {
-    char cache_path[512];
-    snprintf(cache_path, sizeof(cache_path), "/mnt/SDCARD/.shadercache/%s.bin", cache_key);
-
-    GLuint program = glCreateProgram();
-    GLint success;
-
-    // Try to load cached binary first
-    FILE *f = fopen(cache_path, "rb");
-    if (f) {
-        GLint binaryFormat;
-        fread(&binaryFormat, sizeof(GLint), 1, f);
-        fseek(f, 0, SEEK_END);
-        size_t length = ftell(f) - sizeof(GLint);
-        fseek(f, sizeof(GLint), SEEK_SET);
-        void *binary = malloc(length);
-        fread(binary, 1, length, f);
-        fclose(f);
-
-        glProgramBinary(program, binaryFormat, binary, length);
-        free(binary);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (success) {
-            LOG_info("Loaded shader program from cache: %s\n", cache_key);
-            return program;
-        } else {
-            LOG_info("Cache load failed, falling back to compile.\n");
-            glDeleteProgram(program);
-            program = glCreateProgram();
-        }
-    }
+// Program binaries are cached per shader on the SD card. Each entry carries a header
+// with a hash over the preprocessed vertex+fragment source and the GL renderer/version,
+// so edited shaders or a firmware/driver update invalidate the entry instead of
+// silently failing glProgramBinary and compiling at game start.
+#define SHADERCACHE_FOLDER SDCARD_PATH "/.shadercache"
+#define SHADERCACHE_MAGIC 0x4353584E // "NXSC"
+#define SHADERCACHE_VERSION 2
+
+typedef struct ShaderCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t hash;
+	uint32_t format;
+	uint32_t length;
+} ShaderCacheHeader;
+
+static uint64_t shader_cache_fnv1a(uint64_t hash, const char* str) {
+	if (!str) return hash;
+	while (*str) {
+		hash ^= (uint8_t)*str++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
 
-    // Compile and link if cache failed
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
+static uint64_t shader_cache_hash(const char* vertex_source, const char* fragment_source) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = shader_cache_fnv1a(hash, (const char*)glGetString(GL_RENDERER));
+	hash = shader_cache_fnv1a(hash, (const char*)glGetString(GL_VERSION));
+	hash = shader_cache_fnv1a(hash, vertex_source);
+	hash = shader_cache_fnv1a(hash, "\n--\n");
+	hash = shader_cache_fnv1a(hash, fragment_source);
+	return hash;
+}
 
-    if (!success) {
-        GLint logLength;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-        char* log = (char*)malloc(logLength);
-        glGetProgramInfoLog(program, logLength, &logLength, log);
-        printf("Program link error: %s\n", log);
-        free(log);
-        return program;
-    }
+static void shader_cache_path(char* out, size_t size, const char* cache_key) {
+	snprintf(out, size, SHADERCACHE_FOLDER "/%s.bin", cache_key);
+}
 
-    GLint binaryLength;
-    GLenum binaryFormat;
-    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
-    void* binary = malloc(binaryLength);
-    glGetProgramBinary(program, binaryLength, NULL, &binaryFormat, binary);
-
-    mkdir("/mnt/SDCARD/.shadercache", 0755); 
-    f = fopen(cache_path, "wb");
-    if (f) {
-        fwrite(&binaryFormat, sizeof(GLenum), 1, f);
-        fwrite(binary, 1, binaryLength, f);
-        fclose(f);
-        LOG_info("Saved shader program to cache: %s\n", cache_key);
-    }
-    free(binary);
+// returns 1 if a cache entry exists for this key and matches hash, fills header
+static int shader_cache_probe(const char* cache_key, uint64_t hash, FILE** out_file, ShaderCacheHeader* out_header) {
+	char cache_path[512];
+	shader_cache_path(cache_path, sizeof(cache_path), cache_key);
 
-    LOG_info("Program linked and cached\n");
-    return program;
+	FILE* f = fopen(cache_path, "rb");
+	if (!f) return 0;
+
+	ShaderCacheHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+		header.magic != SHADERCACHE_MAGIC ||
+		header.version != SHADERCACHE_VERSION ||
+		header.hash != hash ||
+		header.length == 0) {
+		fclose(f);
+		return 0;
+	}
+
+	if (out_header) *out_header = header;
+	if (out_file) *out_file = f;
+	else fclose(f);
+	return 1;
+}
+
+static GLuint shader_cache_load(const char* cache_key, uint64_t hash) {
+	FILE* f = NULL;
+	ShaderCacheHeader header;
+	if (!shader_cache_probe(cache_key, hash, &f, &header)) return 0;
+
+	void* binary = malloc(header.length);
+	if (!binary || fread(binary, 1, header.length, f) != header.length) {
+		free(binary);
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary, header.length);
+	free(binary);
+
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		LOG_info("Shader cache rejected by driver: %s\n", cache_key);
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+static void shader_cache_store(const char* cache_key, uint64_t hash, GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	void* binary = malloc(length);
+	if (!binary) return;
+
+	GLenum format = 0;
+	glGetProgramBinary(program, length, NULL, &format, binary);
+
+	ShaderCacheHeader header = {
+		.magic = SHADERCACHE_MAGIC,
+		.version = SHADERCACHE_VERSION,
+		.hash = hash,
+		.format = format,
+		.length = (uint32_t)length,
+	};
+
+	char cache_path[512];
+	char tmp_path[520];
+	shader_cache_path(cache_path, sizeof(cache_path), cache_key);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+
+	mkdir(SHADERCACHE_FOLDER, 0755);
+	FILE* f = fopen(tmp_path, "wb");
+	if (f) {
+		int ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(binary, 1, length, f) == (size_t)length;
+		fclose(f);
+		if (ok && rename(tmp_path, cache_path) == 0) LOG_info("Saved shader program to cache: %s\n", cache_key);
+		else unlink(tmp_path);
+	}
+	free(binary);
+}
+
+static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader) {
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		GLint logLength;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		char* log = (char*)malloc(logLength);
+		glGetProgramInfoLog(program, logLength, &logLength, log);
+		printf("Program link error: %s\n", log);
+		free(log);
+	}
+	return program;
 }
 
 char* load_shader_source(const char* filename) {
@@ -316,20 +451,20 @@ char* load_shader_source(const char* filename) {
     return source;
 }
 
-GLuint load_shader_from_file(GLenum type, const char* filename, const char* path) {
+// Returns the final GLSL for one stage (version/define/precision header applied,
+// pragma parameters stripped). Caller must free.
+static char* preprocess_shader_source(GLenum type, const char* filename, const char* path) {
     char filepath[256];
     snprintf(filepath, sizeof(filepath), "%s/%s", path, filename);
     char* source = load_shader_source(filepath);
-    if (!source) return 0;
-
-    LOG_info("load shader from file %s\n", filepath);
+    if (!source) return NULL;
 
     // Filter out lines starting with "#pragma parameter"
     char* cleaned = malloc(strlen(source) + 1);
     if (!cleaned) {
         fprintf(stderr, "Out of memory\n");
         free(source);
-        return 0;
+        return NULL;
     }
     cleaned[0] = '\0';
 
@@ -365,7 +500,7 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
         fprintf(stderr, "Unsupported shader type\n");
         free(source);
         free(cleaned);
-        return 0;
+        return NULL;
     }
 
     const char* version_start = strstr(cleaned, "#version");
@@ -416,7 +551,7 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
             fprintf(stderr, "Out of memory\n");
             free(source);
             free(cleaned);
-            return 0;
+            return NULL;
         }
 
         strcpy(combined, replacement_version);
@@ -431,7 +566,7 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
             fprintf(stderr, "Out of memory\n");
             free(source);
             free(cleaned);
-            return 0;
+            return NULL;
         }
 
         memcpy(combined, cleaned, header_len);
@@ -447,7 +582,7 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
             fprintf(stderr, "Out of memory\n");
             free(source);
             free(cleaned);
-            return 0;
+            return NULL;
         }
 
         strcpy(combined, fallback_version);
@@ -456,14 +591,17 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
         strcat(combined, cleaned);
     }
 
-    GLuint shader = glCreateShader(type);
-    const char* combined_ptr = combined;
-    glShaderSource(shader, 1, &combined_ptr, NULL);
-    glCompileShader(shader);
-
     free(source);
     free(cleaned);
-    free(combined);
+    return combined;
+}
+
+static GLuint compile_shader_source(GLenum type, const char* source) {
+    if (!source) return 0;
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
 
     GLint compiled;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
@@ -478,20 +616,154 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
     return shader;
 }
 
+// Loads a program from the validated binary cache, or compiles, links and caches it.
+GLuint load_program(const char* filename, const char* path, const char* cache_key) {
+    char* vertex_source = preprocess_shader_source(GL_VERTEX_SHADER, filename, path);
+    char* fragment_source = preprocess_shader_source(GL_FRAGMENT_SHADER, filename, path);
+    if (!vertex_source || !fragment_source) {
+        free(vertex_source);
+        free(fragment_source);
+        return 0;
+    }
+
+    uint64_t hash = shader_cache_hash(vertex_source, fragment_source);
+    GLuint program = shader_cache_load(cache_key, hash);
+    if (program) {
+        LOG_info("Loaded shader program from cache: %s\n", cache_key);
+        free(vertex_source);
+        free(fragment_source);
+        return program;
+    }
+
+    LOG_info("Compiling shader program %s/%s\n", path, filename);
+    GLuint vertex = compile_shader_source(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment = compile_shader_source(GL_FRAGMENT_SHADER, fragment_source);
+    free(vertex_source);
+    free(fragment_source);
+
+    program = link_program(vertex, fragment);
+    if (vertex) glDeleteShader(vertex);
+    if (fragment) glDeleteShader(fragment);
+
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success) shader_cache_store(cache_key, hash, program);
+
+    return program;
+}
+
+// Pre-warming compiles every shader referenced by the shader presets (and the
+// system shaders) into the cache ahead of time, one program per call, so nextui
+// can spread the work over idle frames.
+typedef struct ShaderWarmEntry {
+	char filename[256];
+	const char* path;
+	char cache_key[256];
+} ShaderWarmEntry;
+
+static ShaderWarmEntry* shader_warm_entries = NULL;
+static int shader_warm_count = -1;
+static int shader_warm_index = 0;
+
+static void shader_warm_add(const char* filename, const char* path, const char* cache_key) {
+	for (int i = 0; i < shader_warm_count; i++) {
+		if (exactMatch(shader_warm_entries[i].cache_key, cache_key)) return;
+	}
+	ShaderWarmEntry* entries = realloc(shader_warm_entries, sizeof(ShaderWarmEntry) * (shader_warm_count + 1));
+	if (!entries) return;
+	shader_warm_entries = entries;
+
+	ShaderWarmEntry* entry = &shader_warm_entries[shader_warm_count++];
+	snprintf(entry->filename, sizeof(entry->filename), "%s", filename);
+	snprintf(entry->cache_key, sizeof(entry->cache_key), "%s", cache_key);
+	entry->path = path;
+}
+
+static void shader_warm_collect(void) {
+	shader_warm_count = 0;
+	shader_warm_index = 0;
+
+	shader_warm_add("default.glsl", SYSSHADERS_FOLDER, "defaultv2.glsl");
+	shader_warm_add("overlay.glsl", SYSSHADERS_FOLDER, "overlay.glsl");
+	shader_warm_add("noshader.glsl", SYSSHADERS_FOLDER, "noshader.glsl");
+	shader_warm_add("transition.glsl", SYSSHADERS_FOLDER, "transition.glsl");
+
+	DIR* dir = opendir(SHADERS_FOLDER);
+	if (!dir) return;
+
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.' || !suffixMatch(".cfg", entry->d_name)) continue;
+
+		char preset_path[512];
+		snprintf(preset_path, sizeof(preset_path), SHADERS_FOLDER "/%s", entry->d_name);
+		FILE* f = fopen(preset_path, "r");
+		if (!f) continue;
+
+		char line[512];
+		while (fgets(line, sizeof(line), f)) {
+			int nr;
+			char filename[256];
+			if (sscanf(line, "minarch_shader%d = %255s", &nr, filename) != 2) continue;
+			if (!suffixMatch(".glsl", filename)) continue;
+
+			char shader_path[512];
+			snprintf(shader_path, sizeof(shader_path), SHADERS_FOLDER "/glsl/%s", filename);
+			if (exists(shader_path)) shader_warm_add(filename, SHADERS_FOLDER "/glsl", filename);
+		}
+		fclose(f);
+	}
+	closedir(dir);
+	LOG_info("shader cache pre-warm: %i programs referenced\n", shader_warm_count);
+}
+
+int PLAT_warmShaderCache(void) {
+	if (shader_warm_count < 0) shader_warm_collect();
+
+	// one shader per call, cached or not, so the caller can keep its frame
+	// pacing and react to input between calls
+	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
+	if (shader_warm_index < shader_warm_count) {
+		ShaderWarmEntry* entry = &shader_warm_entries[shader_warm_index++];
+
+		char* vertex_source = preprocess_shader_source(GL_VERTEX_SHADER, entry->filename, entry->path);
+		char* fragment_source = preprocess_shader_source(GL_FRAGMENT_SHADER, entry->filename, entry->path);
+		int cached = !vertex_source || !fragment_source ||
+			shader_cache_probe(entry->cache_key, shader_cache_hash(vertex_source, fragment_source), NULL, NULL);
+		free(vertex_source);
+		free(fragment_source);
+		if (cached) return 1; // valid entry (or unreadable source), nothing to compile
+
+		GLuint program = load_program(entry->filename, entry->path, entry->cache_key);
+		if (program) glDeleteProgram(program);
+		return 1;
+	}
+
+	if (shader_warm_entries) {
+		free(shader_warm_entries);
+		shader_warm_entries = NULL;
+	}
+	return 0;
+}
+
+static void initTransitionShader(void) {
+	// only OutputSize goes through runShaderPass, the rest is set per frame
+	transition.shader = (Shader){
+		.texw = device_width, .texh = device_height,
+		.u_FrameDirection = -1, .u_FrameCount = -1, .u_TextureSize = -1,
+		.u_InputSize = -1, .OrigInputSize = -1, .texLocation = -1, .texelSizeLocation = -1,
+	};
+	transition.shader.u_OutputSize = glGetUniformLocation(g_shader_transition, "OutputSize");
+	transition.u_Progress = glGetUniformLocation(g_shader_transition, "Progress");
+	transition.u_Mode = glGetUniformLocation(g_shader_transition, "Mode");
+}
+
 void PLAT_initShaders() {
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 	glViewport(0, 0, device_width, device_height);
 	
-	GLuint vertex;
-	GLuint fragment;
-
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "default.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "default.glsl",SYSSHADERS_FOLDER);
-	g_shader_default = link_program(vertex, fragment,"defaultv2.glsl");
-
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "overlay.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "overlay.glsl",SYSSHADERS_FOLDER);
-	g_shader_overlay = link_program(vertex, fragment,"overlay.glsl");
+	g_shader_default = load_program("default.glsl", SYSSHADERS_FOLDER, "defaultv2.glsl");
+	g_shader_overlay = load_program("overlay.glsl", SYSSHADERS_FOLDER, "overlay.glsl");
 
 
 	// Multiply overlays are handled via GL blend state + preprocessed mask textures.
@@ -499,9 +771,9 @@ void PLAT_initShaders() {
 	g_shader_overlay_mul = g_shader_overlay;
 
 
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
-	g_noshader = link_program(vertex, fragment,"noshader.glsl");
+	g_noshader = load_program("noshader.glsl", SYSSHADERS_FOLDER, "noshader.glsl");
+	g_shader_transition = load_program("transition.glsl", SYSSHADERS_FOLDER, "transition.glsl");
+	initTransitionShader();
 	
 	LOG_info("default shaders loaded, %i\n\n",g_shader_default);
 }
@@ -681,15 +953,11 @@ void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int
 		const char *shaderSource  = load_shader_source(filepath);
 		loadShaderPragmas(shader,shaderSource);
 
-		GLuint vertex_shader1 = load_shader_from_file(GL_VERTEX_SHADER, filename,SHADERS_FOLDER "/glsl");
-		GLuint fragment_shader1 = load_shader_from_file(GL_FRAGMENT_SHADER, filename,SHADERS_FOLDER "/glsl");
-			
-        // Link the shader program
 		if (shader->shader_p != 0) {
 			LOG_info("Deleting previous shader %i\n",shader->shader_p);
 			glDeleteProgram(shader->shader_p);
 		}
-        shader->shader_p = link_program(vertex_shader1, fragment_shader1,filename);
+        shader->shader_p = load_program(filename, SHADERS_FOLDER "/glsl", filename);
         
 		shader->u_FrameDirection = glGetUniformLocation( shader->shader_p, "FrameDirection");
 		shader->u_FrameCount = glGetUniformLocation( shader->shader_p, "FrameCount");
@@ -818,6 +1086,7 @@ static void clearVideo(void) {
 	}
 }
 
+
 void PLAT_quitVideo(void) {
 	clearVideo();
 
@@ -834,6 +1103,7 @@ void PLAT_quitVideo(void) {
 	if (vid.target_layer2) SDL_DestroyTexture(vid.target_layer2);
 	if (vid.target_layer4) SDL_DestroyTexture(vid.target_layer4);
 	if (vid.target_layer5) SDL_DestroyTexture(vid.target_layer5);
+	TexPool_quit();
 	if (overlay_path) free(overlay_path);
 	SDL_DestroyTexture(vid.stream_layer1);
 	SDL_DestroyRenderer(vid.renderer);
@@ -946,6 +1216,23 @@ static void rgb565_to_rgb888(uint32_t rgb565, uint8_t *r, uint8_t *g, uint8_t *b
     *g = (green << 2) | (green >> 4);
     *b = (blue << 3) | (blue >> 2);
 }
+// prepareFrameThread sleeps on frame_prep_cond until one of the effect/overlay
+// setters changes something, starts pending so the first pass picks up the
+// settings applied before the thread existed.
+static SDL_mutex* frame_prep_mutex = NULL;
+static SDL_cond* frame_prep_cond = NULL;
+static int frame_prep_pending = 1;
+static void wakeFramePrep(void) {
+	if (!frame_prep_mutex) {
+		frame_prep_pending = 1;
+		return;
+	}
+	SDL_LockMutex(frame_prep_mutex);
+	frame_prep_pending = 1;
+	SDL_CondSignal(frame_prep_cond);
+	SDL_UnlockMutex(frame_prep_mutex);
+}
+
 static char* effect_path;
 static int effectUpdated = 0;
 static void updateEffect(void) {
@@ -1039,6 +1326,7 @@ void PLAT_setOverlay(const char* filename, const char* tag) {
     if (!filename || strcmp(filename, "") == 0) {
 		overlay_path = strdup("");
         printf("Skipping overlay update.\n");
+		wakeFramePrep();
         return;
     }
 
@@ -1052,7 +1340,7 @@ void PLAT_setOverlay(const char* filename, const char* tag) {
 
     snprintf(overlay_path, path_len, "%s/%s/%s", OVERLAYS_FOLDER, tag, filename);
     printf("Overlay path set to: %s\n", overlay_path);
-
+	wakeFramePrep();
 }
 
 void applyRoundedCorners(SDL_Surface* surface, SDL_Rect* rect, int radius) {
@@ -1106,20 +1394,14 @@ void PLAT_clearLayers(int layer) {
 
 	SDL_SetRenderTarget(vid.renderer, NULL);
 }
+
 void PLAT_drawOnLayer(SDL_Surface *inputSurface, int x, int y, int w, int h, float brightness, bool maintainAspectRatio,int layer) {
     if (!inputSurface || !vid.target_layer1 || !vid.renderer) return; 
 
-    SDL_Texture* tempTexture = SDL_CreateTexture(vid.renderer,
-                                                 SDL_PIXELFORMAT_RGBA8888, 
-                                                 SDL_TEXTUREACCESS_TARGET,  
-                                                 inputSurface->w, inputSurface->h); 
-
-    if (!tempTexture) {
-        printf("Failed to create temporary texture: %s\n", SDL_GetError());
-        return;
-    }
+    PooledTexture* pooled = TexPool_acquire(vid.renderer, inputSurface);
+    if (!pooled) return;
+    SDL_Texture* tempTexture = pooled->texture;
 
-    SDL_UpdateTexture(tempTexture, NULL, inputSurface->pixels, inputSurface->pitch);
     switch (layer)
 	{
 	case 1:
@@ -1168,7 +1450,7 @@ void PLAT_drawOnLayer(SDL_Surface *inputSurface, int x, int y, int w, int h, flo
 
     SDL_RenderCopy(vid.renderer, tempTexture, &srcRect, &dstRect);
     SDL_SetRenderTarget(vid.renderer, NULL);
-    SDL_DestroyTexture(tempTexture);
+    TexPool_release(pooled);
 }
 
 
@@ -1184,17 +1466,9 @@ void PLAT_animateSurface(
 ) {
 	if (!inputSurface || !vid.target_layer2 || !vid.renderer) return;
 
-	SDL_Texture* tempTexture = SDL_CreateTexture(vid.renderer,
-		SDL_PIXELFORMAT_RGBA8888,
-		SDL_TEXTUREACCESS_TARGET,
-		inputSurface->w, inputSurface->h);
-
-	if (!tempTexture) {
-		printf("Failed to create temporary texture: %s\n", SDL_GetError());
-		return;
-	}
-
-	SDL_UpdateTexture(tempTexture, NULL, inputSurface->pixels, inputSurface->pitch);
+	PooledTexture* pooled = TexPool_acquire(vid.renderer, inputSurface);
+	if (!pooled) return;
+	SDL_Texture* tempTexture = pooled->texture;
 	SDL_SetTextureBlendMode(tempTexture, SDL_BLENDMODE_BLEND);  // Enable blending for opacity
 
 	const int fps = 60;
@@ -1231,7 +1505,7 @@ void PLAT_animateSurface(
 		PLAT_GPU_Flip();
 	}
 
-	SDL_DestroyTexture(tempTexture);
+	TexPool_release(pooled);
 }
 
 static int text_offset = 0;
@@ -1339,17 +1613,9 @@ void PLAT_animateSurfaceOpacity(
 ) {
 	if (!inputSurface) return;
 
-	SDL_Texture* tempTexture = SDL_CreateTexture(vid.renderer,
-		SDL_PIXELFORMAT_RGBA8888,
-		SDL_TEXTUREACCESS_TARGET,
-		inputSurface->w, inputSurface->h);
-
-	if (!tempTexture) {
-		printf("Failed to create temporary texture: %s\n", SDL_GetError());
-		return;
-	}
-
-	SDL_UpdateTexture(tempTexture, NULL, inputSurface->pixels, inputSurface->pitch);
+	PooledTexture* pooled = TexPool_acquire(vid.renderer, inputSurface);
+	if (!pooled) return;
+	SDL_Texture* tempTexture = pooled->texture;
 	SDL_SetTextureBlendMode(tempTexture, SDL_BLENDMODE_BLEND); 
 
 	const int fps = 60;
@@ -1358,7 +1624,7 @@ void PLAT_animateSurfaceOpacity(
 
 	SDL_Texture* target_layer = (layer == 0) ? vid.target_layer2 : vid.target_layer4;
 	if (!target_layer) {
-		SDL_DestroyTexture(tempTexture);
+		TexPool_release(pooled);
 		return;
 	}
 
@@ -1384,7 +1650,7 @@ void PLAT_animateSurfaceOpacity(
 
 	}
 
-	SDL_DestroyTexture(tempTexture);
+	TexPool_release(pooled);
 }
 
 SDL_Surface* PLAT_captureRendererToSurface() {
@@ -1431,26 +1697,19 @@ void PLAT_animateAndFadeSurface(
 ) {
 	if (!inputSurface || !vid.renderer) return;
 
-	SDL_Texture* moveTexture = SDL_CreateTexture(vid.renderer,
-		SDL_PIXELFORMAT_RGBA8888,
-		SDL_TEXTUREACCESS_TARGET,
-		inputSurface->w, inputSurface->h);
-
-	if (!moveTexture) {
-		printf("Failed to create move texture: %s\n", SDL_GetError());
-		return;
-	}
-
-	SDL_UpdateTexture(moveTexture, NULL, inputSurface->pixels, inputSurface->pitch);
+	PooledTexture* pooledMove = TexPool_acquire(vid.renderer, inputSurface);
+	if (!pooledMove) return;
+	SDL_Texture* moveTexture = pooledMove->texture;
 
+	PooledTexture* pooledFade = NULL;
 	SDL_Texture* fadeTexture = NULL;
 	if (fadeSurface) {
-		fadeTexture = SDL_CreateTextureFromSurface(vid.renderer, fadeSurface);
-		if (!fadeTexture) {
-			printf("Failed to create fade texture: %s\n", SDL_GetError());
-			SDL_DestroyTexture(moveTexture);
+		pooledFade = TexPool_acquire(vid.renderer, fadeSurface);
+		if (!pooledFade) {
+			TexPool_release(pooledMove);
 			return;
 		}
+		fadeTexture = pooledFade->texture;
 		SDL_SetTextureBlendMode(fadeTexture, SDL_BLENDMODE_BLEND);
 	}
 
@@ -1510,15 +1769,17 @@ void PLAT_animateAndFadeSurface(
 
 	}
 
-	SDL_DestroyTexture(moveTexture);
-	if (fadeTexture) SDL_DestroyTexture(fadeTexture);
+	TexPool_release(pooledMove);
+	TexPool_release(pooledFade);
 }
 
 void PLAT_setEffect(int next_type) {
 	effect.next_type = next_type;
+	wakeFramePrep();
 }
 void PLAT_setEffectColor(int next_color) {
 	effect.next_color = next_color;
+	wakeFramePrep();
 }
 void PLAT_vsync(int remaining) {
 	if (remaining>0) SDL_Delay(remaining);
@@ -1526,7 +1787,10 @@ void PLAT_vsync(int remaining) {
 
 scaler_t PLAT_getScaler(GFX_Renderer* renderer) {
 	// LOG_info("getScaler for scale: %i\n", renderer->scale);
-	effect.next_scale = renderer->scale;
+	if (effect.next_scale != renderer->scale) {
+		effect.next_scale = renderer->scale;
+		wakeFramePrep();
+	}
 	return scale1x1_c16;
 }
 
@@ -1798,7 +2062,6 @@ typedef struct {
 } FramePreparation;
 
 static FramePreparation frame_prep = {0};
-static SDL_mutex* frame_prep_mutex = NULL;
 
 // Upload an SDL surface to an existing GL texture.
 // Handles pitch padding and forces a known pixel layout.
@@ -2040,8 +2303,135 @@ static void split_overlay_surface(SDL_Surface* src_abgr8888,
 }
 
 
+// Split overlay layers are cached as raw ABGR8888 next to the shader cache so
+// switching overlays is one read and one upload instead of a png decode plus
+// split_overlay_surface(). Entries are keyed by path and invalidated by the
+// source file's mtime/size.
+#define OVERLAYCACHE_FOLDER SDCARD_PATH "/.overlaycache"
+#define OVERLAYCACHE_MAGIC 0x4F43584E // "NXCO"
+#define OVERLAYCACHE_VERSION 1
+
+typedef struct OverlayCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	int64_t mtime;
+	int64_t size;
+	int32_t w;
+	int32_t h;
+	uint32_t has_mask;
+	uint32_t has_frame;
+} OverlayCacheHeader;
+
+static void overlay_cache_path(char* out, size_t size, const char* overlay_path) {
+	snprintf(out, size, OVERLAYCACHE_FOLDER "/%016llx.bin", (unsigned long long)shader_cache_fnv1a(0xcbf29ce484222325ULL, overlay_path));
+}
+
+static SDL_Surface* overlay_cache_read_layer(FILE* f, int w, int h) {
+	SDL_Surface* layer = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ABGR8888);
+	if (!layer) return NULL;
+	for (int y = 0; y < h; y++) {
+		if (fread((uint8_t*)layer->pixels + (size_t)y * layer->pitch, 4, w, f) != (size_t)w) {
+			SDL_FreeSurface(layer);
+			return NULL;
+		}
+	}
+	return layer;
+}
+
+static int overlay_cache_write_layer(FILE* f, SDL_Surface* layer) {
+	for (int y = 0; y < layer->h; y++) {
+		if (fwrite((uint8_t*)layer->pixels + (size_t)y * layer->pitch, 4, layer->w, f) != (size_t)layer->w) return 0;
+	}
+	return 1;
+}
+
+static int overlay_cache_load(const char* overlay_path, struct stat* st, SDL_Surface** out_mask, SDL_Surface** out_frame) {
+	char cache_path[512];
+	overlay_cache_path(cache_path, sizeof(cache_path), overlay_path);
+
+	FILE* f = fopen(cache_path, "rb");
+	if (!f) return 0;
+
+	OverlayCacheHeader header;
+	SDL_Surface* mask = NULL;
+	SDL_Surface* frame = NULL;
+	int ok = fread(&header, sizeof(header), 1, f) == 1 &&
+		header.magic == OVERLAYCACHE_MAGIC && header.version == OVERLAYCACHE_VERSION &&
+		header.mtime == (int64_t)st->st_mtime && header.size == (int64_t)st->st_size &&
+		header.w > 0 && header.h > 0;
+	if (ok && header.has_mask) ok = (mask = overlay_cache_read_layer(f, header.w, header.h)) != NULL;
+	if (ok && header.has_frame) ok = (frame = overlay_cache_read_layer(f, header.w, header.h)) != NULL;
+	fclose(f);
+
+	if (!ok) {
+		if (mask) SDL_FreeSurface(mask);
+		if (frame) SDL_FreeSurface(frame);
+		return 0;
+	}
+	*out_mask = mask;
+	*out_frame = frame;
+	return 1;
+}
+
+static void overlay_cache_store(const char* overlay_path, struct stat* st, SDL_Surface* mask, SDL_Surface* frame) {
+	SDL_Surface* any = mask ? mask : frame;
+	if (!any) return;
+
+	OverlayCacheHeader header = {
+		.magic = OVERLAYCACHE_MAGIC,
+		.version = OVERLAYCACHE_VERSION,
+		.mtime = (int64_t)st->st_mtime,
+		.size = (int64_t)st->st_size,
+		.w = any->w,
+		.h = any->h,
+		.has_mask = mask != NULL,
+		.has_frame = frame != NULL,
+	};
+
+	char cache_path[512];
+	char tmp_path[520];
+	overlay_cache_path(cache_path, sizeof(cache_path), overlay_path);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cache_path);
+
+	mkdir(OVERLAYCACHE_FOLDER, 0755);
+	FILE* f = fopen(tmp_path, "wb");
+	if (!f) return;
+	int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	if (ok && mask) ok = overlay_cache_write_layer(f, mask);
+	if (ok && frame) ok = overlay_cache_write_layer(f, frame);
+	fclose(f);
+	if (!ok || rename(tmp_path, cache_path) != 0) unlink(tmp_path);
+}
+
+static void loadOverlayLayers(const char* path, SDL_Surface** out_mask, SDL_Surface** out_frame) {
+	*out_mask = NULL;
+	*out_frame = NULL;
+
+	struct stat st;
+	if (stat(path, &st) != 0) return;
+	if (overlay_cache_load(path, &st, out_mask, out_frame)) {
+		LOG_info("overlay loaded from cache %s\n", path);
+		return;
+	}
+
+	SDL_Surface* tmp = IMG_Load(path);
+	if (!tmp) return;
+	SDL_Surface* loaded = SDL_ConvertSurfaceFormat(tmp, SDL_PIXELFORMAT_ABGR8888, 0);
+	SDL_FreeSurface(tmp);
+	if (!loaded) return;
+
+	split_overlay_surface(loaded, out_mask, out_frame, path);
+	SDL_FreeSurface(loaded);
+	overlay_cache_store(path, &st, *out_mask, *out_frame);
+}
+
 int prepareFrameThread(void *data) {
     while (1) {
+		SDL_LockMutex(frame_prep_mutex);
+		while (!frame_prep_pending) SDL_CondWait(frame_prep_cond, frame_prep_mutex);
+		frame_prep_pending = 0;
+		SDL_UnlockMutex(frame_prep_mutex);
+
 		updateEffect();
 
         if (effectUpdated) {
@@ -2081,16 +2471,8 @@ int prepareFrameThread(void *data) {
 			SDL_Surface* loaded_mask = NULL;
 			SDL_Surface* loaded_frame = NULL;
 
-			if (overlay_path) {
-				SDL_Surface* tmp = IMG_Load(overlay_path);
-				if (tmp) {
-					SDL_Surface* loaded = SDL_ConvertSurfaceFormat(tmp, SDL_PIXELFORMAT_ABGR8888, 0);
-					SDL_FreeSurface(tmp);
-					if (loaded) {
-						split_overlay_surface(loaded, &loaded_mask, &loaded_frame, overlay_path);
-						SDL_FreeSurface(loaded);
-					}
-				}
+			if (overlay_path && overlay_path[0]) {
+				loadOverlayLayers(overlay_path, &loaded_mask, &loaded_frame);
 			}
 
 			SDL_LockMutex(frame_prep_mutex);
@@ -2102,12 +2484,55 @@ int prepareFrameThread(void *data) {
 			overlayUpdated = 0;
 			SDL_UnlockMutex(frame_prep_mutex);
         }
-
-        SDL_Delay(120); 
     }
     return 0;
 }
 
+// Streaming upload: the core frame is copied into one of a small ring of pixel
+// unpack buffers and the texture is filled from that buffer, so the driver can
+// DMA it while we keep going instead of stalling on a synchronous glTexSubImage2D.
+#define UPLOAD_PBO_COUNT 3
+static int stream_upload = 0;
+static GLuint upload_pbos[UPLOAD_PBO_COUNT] = {0};
+static GLsizeiptr upload_pbo_sizes[UPLOAD_PBO_COUNT] = {0};
+static int upload_pbo_index = 0;
+
+void PLAT_setStreamUpload(int enable) {
+	stream_upload = enable;
+}
+
+// expects src_texture to be bound, returns 0 if the caller should fall back to a direct upload
+static int uploadFrameStreamed(const void* pixels, int w, int h, int realloc) {
+	GLsizeiptr size = (GLsizeiptr)w * h * 4;
+	if (!upload_pbos[0]) glGenBuffers(UPLOAD_PBO_COUNT, upload_pbos);
+
+	upload_pbo_index = (upload_pbo_index + 1) % UPLOAD_PBO_COUNT;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_pbos[upload_pbo_index]);
+	if (upload_pbo_sizes[upload_pbo_index] != size) {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		upload_pbo_sizes[upload_pbo_index] = size;
+	}
+
+	void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!dst) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return 0;
+	}
+	memcpy(dst, pixels, size);
+	if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+		// contents got lost (eg. display mode change), let the direct path handle this frame
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return 0;
+	}
+
+	if (realloc) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)0);
+	else glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)0);
+
+	// must unbind or every other texture upload would source from the buffer
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return 1;
+}
+
 static SDL_Thread *prepare_thread = NULL;
 
 void PLAT_GL_Swap() {
@@ -2120,6 +2545,13 @@ void PLAT_GL_Swap() {
 				return;
 			}
 		}
+		if (frame_prep_cond == NULL) {
+			frame_prep_cond = SDL_CreateCond();
+			if (frame_prep_cond == NULL) {
+				printf("Error creating frame preparation condition: %s\n", SDL_GetError());
+				return;
+			}
+		}
         prepare_thread = SDL_CreateThread(prepareFrameThread, "PrepareFrameThread", NULL);
 
         if (prepare_thread == NULL) {
@@ -2142,6 +2574,19 @@ void PLAT_GL_Swap() {
 
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 
+	int transitioning = transition.type != TRANSITION_NONE && transition.progress < 1.0f && g_shader_transition;
+	SDL_Rect final_rect = dst_rect;
+	if (transitioning && transition.type == TRANSITION_ZOOM_FADE) {
+		float eased = transition.progress * transition.progress * (3.0f - 2.0f * transition.progress);
+		float zoom = 6.0f - eased * 5.0f;
+		final_rect.w = dst_rect.w * zoom;
+		final_rect.h = dst_rect.h * zoom;
+		final_rect.x = dst_rect.x + (dst_rect.w - final_rect.w) / 2;
+		final_rect.y = dst_rect.y + (dst_rect.h - final_rect.h) / 2;
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h);
+	}
+
     static GLuint effect_tex = 0;
     static int effect_w = 0, effect_h = 0;
     static GLuint overlay_mask_tex = 0;
@@ -2240,18 +2685,25 @@ void PLAT_GL_Swap() {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
 
+    uint64_t upload_start = getMicroseconds();
     glBindTexture(GL_TEXTURE_2D, src_texture);
-    if (vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vid.blit->src_w, vid.blit->src_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
+    int realloc_src = vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures;
+    if (!stream_upload || !uploadFrameStreamed(vid.blit->src, vid.blit->src_w, vid.blit->src_h, realloc_src)) {
+        if (realloc_src)
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vid.blit->src_w, vid.blit->src_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, vid.blit->src_w, vid.blit->src_h, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
+    }
+    if (realloc_src) {
         src_w_last = vid.blit->src_w;
         src_h_last = vid.blit->src_h;
-    } else {
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, vid.blit->src_w, vid.blit->src_h, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
     }
+    // smoothed so the debug hud is readable, this is cpu side time spent handing the frame to the driver
+    currentuploadus = (currentuploadus * 7 + (int)(getMicroseconds() - upload_start)) / 8;
 
     if (nrofshaders < 1) {
-        runShaderPass(src_texture, g_shader_default, NULL, dst_rect.x, dst_rect.y,
-            dst_rect.w, dst_rect.h,
+        runShaderPass(src_texture, g_shader_default, NULL, final_rect.x, final_rect.y,
+            final_rect.w, final_rect.h,
             &(Shader){.srcw = vid.blit->src_w, .srch = vid.blit->src_h, .texw = vid.blit->src_w, .texh = vid.blit->src_h},
 			BLEND_NONE, GL_NONE);
     }
@@ -2330,12 +2782,14 @@ void PLAT_GL_Swap() {
             shaders[nrofshaders - 1]->texture,
             g_shader_default,
             NULL,
-            dst_rect.x, dst_rect.y, dst_rect.w, dst_rect.h,
+            final_rect.x, final_rect.y, final_rect.w, final_rect.h,
             &(Shader){.srcw = last_w, .srch = last_h, .texw = last_w, .texh = last_h},
 			BLEND_NONE, GL_NONE
         );
     }
 
+    if (transitioning && transition.type == TRANSITION_ZOOM_FADE) glDisable(GL_SCISSOR_TEST);
+
     if (effect_tex) {
         runShaderPass(
             effect_tex,
@@ -2369,6 +2823,14 @@ void PLAT_GL_Swap() {
         );
     }
 
+    if (transitioning) {
+		glUseProgram(g_shader_transition);
+		glUniform1f(transition.u_Progress, transition.progress);
+		glUniform1i(transition.u_Mode, transition.type == TRANSITION_CIRCLE);
+		runShaderPass(0, g_shader_transition, NULL, 0, 0, device_width, device_height,
+			&transition.shader, BLEND_ALPHA, GL_NONE);
+    }
+
     SDL_GL_SwapWindow(vid.window);
     frame_count++;
     reloadShaderTextures = 0;
@@ -2402,6 +2864,17 @@ void PLAT_pixelFlipper(uint8_t* pixels, int width, int height) {
     }
 }
 
+// the context can only be current on one thread at a time, minarch hands
+// it to its render thread while a game runs and takes it back for menus
+void PLAT_GL_setCurrent(int current) {
+	SDL_GL_MakeCurrent(vid.window, current ? vid.gl_context : NULL);
+}
+
+void PLAT_GL_setTransition(int type, float progress) {
+	transition.type = type;
+	transition.progress = progress;
+}
+
 unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight) {
     glViewport(0, 0, device_width, device_height);
     GLint viewport[4];
@@ -2423,6 +2896,63 @@ unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight) {
     return pixels; // caller must free
 }
 
+// Non-blocking variant of PLAT_GL_screenCapture: the readback goes into a pack
+// buffer guarded by a fence and is picked up by PLAT_GL_screenCaptureCollect a
+// frame or two later, so the emulation thread never waits on the GPU.
+static GLuint capture_pbo = 0;
+static GLsync capture_fence = NULL;
+static int capture_w = 0, capture_h = 0;
+
+int PLAT_GL_screenCaptureAsync(void) {
+	if (capture_fence) return 0; // one in flight at a time
+
+	glViewport(0, 0, device_width, device_height);
+	capture_w = device_width;
+	capture_h = device_height;
+
+	if (!capture_pbo) glGenBuffers(1, &capture_pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)capture_w * capture_h * 4, NULL, GL_STREAM_READ);
+	glReadPixels(0, 0, capture_w, capture_h, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	capture_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!capture_fence) return 0;
+	glFlush();
+	return 1;
+}
+
+unsigned char* PLAT_GL_screenCaptureCollect(int* outWidth, int* outHeight, int wait) {
+	if (!capture_fence) return NULL;
+
+	GLenum status = glClientWaitSync(capture_fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ULL : 0);
+	if (status == GL_TIMEOUT_EXPIRED && !wait) return NULL;
+	glDeleteSync(capture_fence);
+	capture_fence = NULL;
+	if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) return NULL;
+
+	size_t size = (size_t)capture_w * capture_h * 4;
+	unsigned char* pixels = malloc(size);
+	if (!pixels) return NULL;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbo);
+	void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (mapped) {
+		memcpy(pixels, mapped, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (!mapped) {
+		free(pixels);
+		return NULL;
+	}
+
+	PLAT_pixelFlipper(pixels, capture_w, capture_h);
+	if (outWidth) *outWidth = capture_w;
+	if (outHeight) *outHeight = capture_h;
+	return pixels; // caller must free
+}
+
 ///////////////////////////////
 
 // TODO: 
@@ -2460,9 +2990,12 @@ void PLAT_getBatteryStatus(int* is_charging, int* charge) {
 	else if (*charge>10) *charge =  20;
 	else           		 *charge =  10;
 }
+#define CPU_TEMP_INTERVAL_MS 1000 // keymon samples at the rate its readers ask for
 void PLAT_getCPUTemp() {
-	currentcputemp = getInt("/sys/devices/virtual/thermal/thermal_zone0/temp")/1000;
-
+	int temp = GetTelemetryTemp(CPU_TEMP_INTERVAL_MS);
+	if (temp < 0) // keymon is gone or hasn't caught up with a new reader yet
+		temp = getInt("/sys/devices/virtual/thermal/thermal_zone0/temp");
+	currentcputemp = temp/1000;
 }
 
 static struct WIFI_connection connection = {
@@ -2504,6 +3037,19 @@ void PLAT_updateNetworkStatus()
 
 void PLAT_getBatteryStatusFine(int *is_charging, int *charge)
 {	
+	// keymon keeps these sampled in shared memory, only read
+	// sysfs ourselves when it isn't publishing
+	Telemetry telemetry;
+	if(GetTelemetry(&telemetry)) {
+		if(is_charging) *is_charging = telemetry.is_charging;
+		if(charge) *charge = telemetry.charge;
+		return;
+	}
+	PLAT_getBatteryStatusDirect(is_charging, charge);
+}
+
+void PLAT_getBatteryStatusDirect(int *is_charging, int *charge)
+{
 	if(is_charging) {
 		int time_to_full = getInt("/sys/class/power_supply/axp2202-battery/time_to_full_now");
 		int charger_present = getInt("/sys/class/power_supply/axp2202-usb/online"); 
@@ -2571,6 +3117,7 @@ static pthread_mutex_t currentcpuinfo;
 
 volatile int useAutoCpu = 1;
 void *PLAT_cpu_monitor(void *arg) {
+	PWR_registerThread(THREAD_PROFILE_BACKGROUND);
     struct timespec start_time, curr_time;
     clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
 
@@ -2705,6 +3252,39 @@ void PLAT_setCPUSpeed(int speed) {
 	putInt(GOVERNOR_PATH, freq);
 }
 
+// cpu0 takes most of the interrupts so it's never the dedicated core,
+// the other registered threads share whatever is left
+#define CORE_COUNT 4
+#define AUDIO_PRIORITY 10 // SCHED_FIFO, above every SCHED_OTHER thread
+#define EMULATION_NICE -5
+#define BACKGROUND_NICE 10
+void PLAT_setThreadProfile(int tid, int profile, int cpu) {
+	unsigned long all = (1UL << CORE_COUNT) - 1;
+	unsigned long mask = all;
+	int policy = SCHED_OTHER;
+	int priority = 0;
+	int nice = 0;
+	if (cpu>0 && cpu<CORE_COUNT) {
+		unsigned long shared = all & ~(1UL << cpu);
+		switch (profile) {
+			case THREAD_PROFILE_EMULATION:  mask = 1UL << cpu; nice = EMULATION_NICE; break;
+			case THREAD_PROFILE_AUDIO:      mask = shared; policy = SCHED_FIFO; priority = AUDIO_PRIORITY; break;
+			case THREAD_PROFILE_RENDER:     mask = shared; break;
+			case THREAD_PROFILE_BACKGROUND: mask = shared; nice = BACKGROUND_NICE; break;
+		}
+	}
+
+	// the raw syscall takes a plain bitmask and doesn't need _GNU_SOURCE
+	if (syscall(SYS_sched_setaffinity, tid, sizeof(mask), &mask)!=0) {
+		LOG_warn("PLAT_setThreadProfile: affinity for %i failed (%s)\n", tid, strerror(errno));
+	}
+	struct sched_param param = { .sched_priority = priority };
+	if (sched_setscheduler(tid, policy, &param)!=0) {
+		LOG_warn("PLAT_setThreadProfile: policy for %i failed (%s)\n", tid, strerror(errno));
+	}
+	if (policy==SCHED_OTHER) setpriority(PRIO_PROCESS, tid, nice);
+}
+
 #define MAX_STRENGTH 0xFFFF
 #define MIN_VOLTAGE 500000
 #define MAX_VOLTAGE 3300000
@@ -4437,6 +5017,8 @@ static void remove_file_watch() {
 static void *watcher_thread_func(void *arg) {
     char buffer[EVENT_BUF_LEN];
 
+    PWR_registerThread(THREAD_PROFILE_BACKGROUND);
+
     // At start try to watch file if exists
     add_file_watch();
 